@@ -0,0 +1,380 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   DHCP client for Wiznet W5500 library for AVR XMEGA
+ * @verbatim
+	Non-blocking DHCP client, last lease kept in EEPROM and requested again after reboot (INIT-REBOOT)
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <avr/eeprom.h>
+#include "W5500.h"
+#include "DHCP.h"
+
+#define DHCP_HEADER_SIZE		240	//BOOTP header with magic cookie
+#define DHCP_MESSAGE_MIN		300	//shorter BOOTP messages are dropped by some relays
+#define DHCP_OPTIONS_SIZE		64
+
+#define DHCP_OPTION_PAD			0
+#define DHCP_OPTION_MASK		1
+#define DHCP_OPTION_ROUTER		3
+#define DHCP_OPTION_DNS			6
+#define DHCP_OPTION_HOSTNAME	12
+#define DHCP_OPTION_REQUESTED	50
+#define DHCP_OPTION_LEASE		51
+#define DHCP_OPTION_TYPE		53
+#define DHCP_OPTION_SERVER		54
+#define DHCP_OPTION_PARAMETERS	55
+#define DHCP_OPTION_T1			58
+#define DHCP_OPTION_T2			59
+#define DHCP_OPTION_END			255
+
+
+//Private prototypes
+
+void dhcpClock(void);
+unsigned long dhcpLong(const unsigned char data[]);
+void dhcpStart(unsigned char state);
+void dhcpSend(unsigned char type);
+unsigned char dhcpTransmit(void);
+void dhcpDrop(void);
+void dhcpBind(unsigned long t1, unsigned long t2);
+void dhcpReceive(void);
+unsigned char dhcpPoll(void);
+
+
+static dhcpLease EEMEM dhcpStoredLease;
+static dhcpLease dhcpCurrent;
+static MACaddress dhcpMAC;
+static unsigned char dhcpSocket;
+static unsigned char dhcpCurrentState;
+static unsigned char dhcpRetries;
+static unsigned long dhcpXid;
+static unsigned int dhcpSent;//schedulerTicks() of the last message
+static unsigned int dhcpTimeout;//ms until retransmission, 0 = send now
+static address dhcpOffered;
+static address dhcpOfferServer;
+static unsigned long dhcpSeconds;//lease clock, TICKS_ELAPSED() alone wraps after 65 s
+static unsigned int dhcpSecondTick;
+static unsigned long dhcpBound;//dhcpSeconds of the last ACK
+static unsigned long dhcpT1, dhcpT2;//s after dhcpBound
+
+
+void dhcpInit(unsigned char socket, MACaddress mac)
+{
+	dhcpSocket = socket;
+	dhcpMAC = mac;
+	dhcpSecondTick = schedulerTicks();
+	dhcpXid = ((unsigned long)mac.b3 << 24) | ((unsigned long)mac.b4 << 16) | ((unsigned int)mac.b5 << 8);
+	
+	eeprom_read_block(&dhcpCurrent, &dhcpStoredLease, sizeof(dhcpLease));
+	if(dhcpCurrent.magic == DHCP_LEASE_MAGIC)
+	{
+		dhcpOffered = dhcpCurrent.ip;
+		dhcpStart(DHCP_REBOOTING);//one REQUEST/ACK round trip instead of DISCOVER/OFFER/REQUEST/ACK
+	}
+	else
+	{
+		dhcpStart(DHCP_INIT);
+	}
+}
+
+unsigned char dhcpState(void)
+{
+	return dhcpCurrentState;
+}
+
+unsigned char dhcpGetLease(dhcpLease *lease)
+{
+	if(dhcpCurrentState < DHCP_BOUND)	return FAIL;
+	*lease = dhcpCurrent;
+	
+	return OK;
+}
+
+void dhcpClock(void)//called at least every 65 s by dhcpTask
+{
+	while(TICKS_ELAPSED(dhcpSecondTick) >= 1000)
+	{
+		dhcpSecondTick += 1000;
+		dhcpSeconds++;
+	}
+}
+
+unsigned long dhcpLong(const unsigned char data[])//big endian
+{
+	return ((unsigned long)data[0] << 24) | ((unsigned long)data[1] << 16) | ((unsigned int)data[2] << 8) | data[3];
+}
+
+void dhcpStart(unsigned char state)
+{
+	dhcpCurrentState = state;
+	dhcpRetries = 0;
+	dhcpTimeout = 0;
+	dhcpXid += 0x1001 + schedulerTicks();
+}
+
+void dhcpSend(unsigned char type)
+{
+	unsigned char message[DHCP_HEADER_SIZE + DHCP_OPTIONS_SIZE];
+	unsigned char *option = message + DHCP_HEADER_SIZE;
+	unsigned char hostnameLength = strlen(DHCP_HOSTNAME);
+	unsigned char bound = (dhcpCurrentState == DHCP_RENEWING || dhcpCurrentState == DHCP_REBINDING);
+	IPaddressAndPort destination = {255, 255, 255, 255, DHCP_SERVER_PORT};
+	unsigned int length;
+	
+	memset(message, 0, sizeof(message));
+	message[0] = 1;//BOOTREQUEST
+	message[1] = 1;//Ethernet
+	message[2] = 6;
+	message[4] = dhcpXid >> 24;
+	message[5] = dhcpXid >> 16;
+	message[6] = dhcpXid >> 8;
+	message[7] = dhcpXid;
+	if(bound)
+	{
+		memcpy(message + 12, &dhcpCurrent.ip, 4);//ciaddr, we can receive unicast answers
+	}
+	else
+	{
+		message[10] = 0x80;//broadcast flag, W5500 without address would not get a unicast answer
+	}
+	memcpy(message + 28, &dhcpMAC, 6);
+	message[236] = 99;//magic cookie
+	message[237] = 130;
+	message[238] = 83;
+	message[239] = 99;
+	
+	*option++ = DHCP_OPTION_TYPE;
+	*option++ = 1;
+	*option++ = type;
+	if(type == DHCP_REQUEST && !bound)//RENEWING and REBINDING must not send these
+	{
+		*option++ = DHCP_OPTION_REQUESTED;
+		*option++ = 4;
+		memcpy(option, &dhcpOffered, 4);
+		option += 4;
+		if(dhcpCurrentState == DHCP_REQUESTING)
+		{
+			*option++ = DHCP_OPTION_SERVER;
+			*option++ = 4;
+			memcpy(option, &dhcpOfferServer, 4);
+			option += 4;
+		}
+	}
+	*option++ = DHCP_OPTION_HOSTNAME;
+	*option++ = hostnameLength;
+	memcpy(option, DHCP_HOSTNAME, hostnameLength);
+	option += hostnameLength;
+	*option++ = DHCP_OPTION_PARAMETERS;
+	*option++ = 6;
+	*option++ = DHCP_OPTION_MASK;
+	*option++ = DHCP_OPTION_ROUTER;
+	*option++ = DHCP_OPTION_DNS;
+	*option++ = DHCP_OPTION_LEASE;
+	*option++ = DHCP_OPTION_T1;
+	*option++ = DHCP_OPTION_T2;
+	*option++ = DHCP_OPTION_END;
+	
+	length = option - message;
+	if(length < DHCP_MESSAGE_MIN)	length = DHCP_MESSAGE_MIN;//zero padding, message[] is cleared
+	
+	if(dhcpCurrentState == DHCP_RENEWING)//unicast to the server that gave us the lease
+	{
+		destination.b0 = dhcpCurrent.server.b0;
+		destination.b1 = dhcpCurrent.server.b1;
+		destination.b2 = dhcpCurrent.server.b2;
+		destination.b3 = dhcpCurrent.server.b3;
+	}
+	ethernetSendDataTo(dhcpSocket, destination, (char *)message, length);
+}
+
+unsigned char dhcpTransmit(void)//DISCOVER or REQUEST for the current state, with retransmission backoff
+{
+	if(ethernetGetStatus(dhcpSocket) != SOCK_UDP)
+	{
+		ethernetSocketClose(dhcpSocket);
+		if(ethernetSocketOpenUDP(dhcpSocket, DHCP_CLIENT_PORT) == FAIL)	return FAIL;
+	}
+	
+	if(dhcpCurrentState == DHCP_INIT)	dhcpCurrentState = DHCP_SELECTING;
+	dhcpSend(dhcpCurrentState == DHCP_SELECTING ? DHCP_DISCOVER : DHCP_REQUEST);
+	dhcpRetries++;
+	dhcpSent = schedulerTicks();
+	if(dhcpTimeout == 0)					dhcpTimeout = DHCP_RETRY_TIMEOUT;
+	else if(dhcpTimeout < DHCP_RETRY_MAX)	dhcpTimeout *= 2;
+	
+	return OK;
+}
+
+void dhcpDrop(void)//lease lost, stop using the address
+{
+	address zero = {0, 0, 0, 0};
+	
+	ethernetInit(zero, zero, zero, dhcpMAC);
+}
+
+void dhcpBind(unsigned long t1, unsigned long t2)
+{
+	dhcpCurrent.magic = DHCP_LEASE_MAGIC;
+	if(dhcpCurrent.leaseTime > 0x7FFFFFFFUL)	dhcpCurrent.leaseTime = 0x7FFFFFFFUL;//infinite
+	dhcpT1 = (t1 && t1 < dhcpCurrent.leaseTime) ? t1 : dhcpCurrent.leaseTime / 2;
+	dhcpT2 = (t2 && t2 < dhcpCurrent.leaseTime) ? t2 : dhcpCurrent.leaseTime / 8 * 7;
+	dhcpBound = dhcpSeconds;
+	
+	ethernetInit(dhcpCurrent.ip, dhcpCurrent.mask, dhcpCurrent.gateway, dhcpMAC);
+	eeprom_update_block(&dhcpCurrent, &dhcpStoredLease, sizeof(dhcpLease));//renewals of the same lease write nothing
+	
+	ethernetSocketClose(dhcpSocket);//no broadcasts piling up in the RX buffer until the next renewal
+	dhcpCurrentState = DHCP_BOUND;
+}
+
+void dhcpReceive(void)
+{
+	unsigned char message[DHCP_RX_SIZE];
+	IPaddressAndPort source;
+	unsigned int length, offset;
+	unsigned char type = 0;
+	unsigned long t1 = 0, t2 = 0;
+	address server, *requested;
+	dhcpLease lease = dhcpCurrent;//options missing from the ACK keep their values, nothing is live before the ACK checks out
+	
+	length = ethernetSocketReceiveDatagram(dhcpSocket, &source, (char *)message, DHCP_RX_SIZE);
+	if(length < DHCP_HEADER_SIZE || message[0] != 2 || dhcpLong(message + 4) != dhcpXid)	return;//not an answer to our last message
+	if(memcmp(message + 28, &dhcpMAC, 6) != 0 || dhcpLong(message + 236) != 0x63825363UL)	return;
+	
+	server.b0 = source.b0;//when the server identifier is missing
+	server.b1 = source.b1;
+	server.b2 = source.b2;
+	server.b3 = source.b3;
+	offset = DHCP_HEADER_SIZE;
+	while(offset < length && message[offset] != DHCP_OPTION_END)
+	{
+		if(message[offset] == DHCP_OPTION_PAD)//single byte option
+		{
+			offset++;
+			continue;
+		}
+		if(offset + 2 > length || offset + 2 + message[offset + 1] > length)	break;
+		if(message[offset + 1] < ((message[offset] == DHCP_OPTION_TYPE) ? 1 : 4))//every other option read is an address or a 32 bit time
+		{
+			offset += 2 + message[offset + 1];//too short, would read into the next option
+			continue;
+		}
+		
+		switch(message[offset])
+		{
+			case DHCP_OPTION_TYPE:		type = message[offset + 2]; break;
+			case DHCP_OPTION_SERVER:	memcpy(&server, message + offset + 2, 4); break;
+			case DHCP_OPTION_LEASE:		lease.leaseTime = dhcpLong(message + offset + 2); break;
+			case DHCP_OPTION_MASK:		memcpy(&lease.mask, message + offset + 2, 4); break;
+			case DHCP_OPTION_ROUTER:	memcpy(&lease.gateway, message + offset + 2, 4); break;//first router
+			case DHCP_OPTION_DNS:		memcpy(&lease.dns, message + offset + 2, 4); break;//first server
+			case DHCP_OPTION_T1:		t1 = dhcpLong(message + offset + 2); break;
+			case DHCP_OPTION_T2:		t2 = dhcpLong(message + offset + 2); break;
+		}
+		offset += 2 + message[offset + 1];
+	}
+	
+	if(type == DHCP_OFFER && dhcpCurrentState == DHCP_SELECTING)
+	{
+		memcpy(&dhcpOffered, message + 16, 4);//yiaddr
+		dhcpOfferServer = server;
+		dhcpStart(DHCP_REQUESTING);
+		dhcpXid = dhcpLong(message + 4);//REQUEST keeps the xid of the OFFER
+		dhcpTransmit();
+	}
+	else if(type == DHCP_ACK && dhcpCurrentState != DHCP_SELECTING && dhcpCurrentState != DHCP_BOUND)
+	{
+		memcpy(&lease.ip, message + 16, 4);
+		requested = (dhcpCurrentState == DHCP_RENEWING || dhcpCurrentState == DHCP_REBINDING) ? &dhcpCurrent.ip : &dhcpOffered;
+		if(memcmp(&lease.ip, requested, 4) != 0)	return;//not the address we asked for
+		if(dhcpCurrentState == DHCP_REQUESTING && memcmp(&server, &dhcpOfferServer, 4) != 0)	return;//ACK of another server
+		lease.server = server;
+		dhcpCurrent = lease;
+		dhcpBind(t1, t2);
+	}
+	else if(type == DHCP_NAK && dhcpCurrentState != DHCP_SELECTING && dhcpCurrentState != DHCP_BOUND)
+	{
+		if(dhcpCurrentState == DHCP_RENEWING || dhcpCurrentState == DHCP_REBINDING)	dhcpDrop();
+		dhcpCurrent.magic = 0;//stored address is no longer ours, next boot starts with DISCOVER
+		eeprom_update_block(&dhcpCurrent.magic, &dhcpStoredLease.magic, sizeof(dhcpCurrent.magic));
+		dhcpStart(DHCP_INIT);
+		dhcpTransmit();
+	}
+}
+
+unsigned char dhcpPoll(void)//OK if something was sent or received
+{
+	unsigned long elapsed;
+	
+	dhcpClock();
+	elapsed = dhcpSeconds - dhcpBound;
+	if(dhcpCurrentState == DHCP_BOUND)
+	{
+		if(elapsed < dhcpT1)	return FAIL;//no SPI traffic during the lease
+		dhcpStart(DHCP_RENEWING);
+	}
+	if(dhcpCurrentState == DHCP_RENEWING || dhcpCurrentState == DHCP_REBINDING)
+	{
+		if(elapsed >= dhcpCurrent.leaseTime)
+		{
+			dhcpDrop();
+			dhcpStart(DHCP_INIT);
+		}
+		else if(dhcpCurrentState == DHCP_RENEWING && elapsed >= dhcpT2)
+		{
+			dhcpStart(DHCP_REBINDING);
+		}
+	}
+	
+	if(dhcpTimeout && ethernetCheckIfReceivedData(dhcpSocket) == OK)
+	{
+		dhcpReceive();
+		return OK;
+	}
+	if(TICKS_ELAPSED(dhcpSent) < dhcpTimeout)	return FAIL;
+	
+	if((dhcpCurrentState == DHCP_REQUESTING && dhcpRetries >= DHCP_RETRIES) || (dhcpCurrentState == DHCP_REBOOTING && dhcpRetries >= DHCP_REBOOT_RETRIES))
+	{
+		dhcpStart(DHCP_INIT);//server is gone or ignores the stored address, full DISCOVER
+	}
+	
+	return dhcpTransmit();
+}
+
+unsigned char dhcpTask(task *t)
+{
+	TASK_BEGIN(t);
+	while(1)
+	{
+		if(dhcpPoll() == OK)
+		{
+			TASK_YIELD(t);
+		}
+		else
+		{
+			TASK_POLL(t);
+		}
+	}
+	TASK_END(t);
+}
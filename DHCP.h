@@ -0,0 +1,81 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   DHCP client for Wiznet W5500 library for AVR XMEGA
+ * @verbatim
+	Non-blocking DHCP client, last lease kept in EEPROM and requested again after reboot (INIT-REBOOT)
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#ifndef DHCP_H_
+#define DHCP_H_
+
+#define DHCP_SERVER_PORT			67
+#define DHCP_CLIENT_PORT			68
+#define DHCP_RX_SIZE				400	//BOOTP header + options read from a reply, the rest is dropped
+#define DHCP_RETRY_TIMEOUT			1000	//ms, doubled with every retry up to DHCP_RETRY_MAX
+#define DHCP_RETRY_MAX				8000	//ms
+#define DHCP_RETRIES				4	//REQUEST without answer before starting again with DISCOVER
+#define DHCP_REBOOT_RETRIES			2	//INIT-REBOOT REQUEST for the stored lease without answer, then DISCOVER
+#define DHCP_LEASE_MAGIC			0x4C45	//dhcpLease.magic of a valid lease in EEPROM
+#ifndef DHCP_HOSTNAME
+#define DHCP_HOSTNAME				CLIENT_HOSTNAME	//option 12, the name the DHCP server may register in DNS, at most 38 characters
+#endif
+
+//dhcpState()
+#define DHCP_INIT					0
+#define DHCP_SELECTING				1	//DISCOVER sent, waiting for OFFER
+#define DHCP_REQUESTING				2	//REQUEST for an offered address sent
+#define DHCP_REBOOTING				3	//INIT-REBOOT, REQUEST for the address from EEPROM sent
+#define DHCP_BOUND					4
+#define DHCP_RENEWING				5	//T1 passed, unicast REQUEST to the server
+#define DHCP_REBINDING				6	//T2 passed, broadcast REQUEST
+
+//message types, option 53
+#define DHCP_DISCOVER				1
+#define DHCP_OFFER					2
+#define DHCP_REQUEST				3
+#define DHCP_ACK					5
+#define DHCP_NAK					6
+
+
+typedef struct structure13
+{
+	unsigned int magic;
+	address ip;
+	address mask;
+	address gateway;
+	address dns;
+	address server;//DHCP server identifier
+	unsigned long leaseTime;//s
+}dhcpLease;
+
+
+//Public prototypes
+
+//ethernetInit(zero, zero, zero, MAC); dhcpInit(SOC7_REG, MAC); schedulerAdd(&dhcpTaskData, dhcpTask, NULL);
+//the leased address, mask and gateway are written by ethernetInit() when the lease is bound
+
+void dhcpInit(unsigned char socket, MACaddress mac);//reads the last lease from EEPROM
+unsigned char dhcpState(void);
+unsigned char dhcpGetLease(dhcpLease *lease);//FAIL while no address is bound
+unsigned char dhcpTask(task *t);//arg unused, runs forever, no SPI traffic while the lease is valid
+
+#endif /* DHCP_H_ */
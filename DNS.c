@@ -0,0 +1,379 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   DNS resolver for Wiznet W5500 library for AVR XMEGA
+ * @verbatim
+	Non-blocking A record lookups over UDP, fixed size cache honoring TTLs, negative caching
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "W5500.h"
+#include "DNS.h"
+
+#define DNS_HEADER_SIZE		12
+#define DNS_TYPE_A			1
+#define DNS_CLASS_IN		1
+#define DNS_RCODE_NXDOMAIN	3
+#define DNS_LABEL_MAX		63	//longer length bytes would read as a compression pointer
+
+
+//Private prototypes
+
+void dnsClock(void);
+unsigned int dnsRandom(void);
+unsigned char dnsWaiting(void);
+unsigned int dnsWord(const unsigned char data[]);
+unsigned char dnsEncodeName(unsigned char buffer[], const char name[]);
+unsigned int dnsSkipName(const unsigned char message[], unsigned int length, unsigned int offset);
+dnsCacheEntry *dnsFind(const char name[]);
+dnsCacheEntry *dnsAllocate(void);
+void dnsSendQuery(dnsCacheEntry *entry);
+unsigned char dnsSendQueries(void);
+void dnsAnswer(dnsCacheEntry *entry, unsigned char resolved, const unsigned char ip[], unsigned long ttl);
+void dnsReceive(void);
+
+
+static dnsCacheEntry dnsCache[DNS_CACHE_SIZE];
+static unsigned char dnsSocket;
+static IPaddressAndPort dnsServer;
+static uint32_t dnsSeed;
+static unsigned long dnsSeconds;//TTL clock, TICKS_ELAPSED() alone wraps after 65 s
+static unsigned int dnsSecondTick;
+
+
+void dnsInit(unsigned char socket, address server)
+{
+	dnsSocket = socket;
+	dnsServer.b0 = server.b0;
+	dnsServer.b1 = server.b1;
+	dnsServer.b2 = server.b2;
+	dnsServer.b3 = server.b3;
+	dnsServer.socketPort = DNS_PORT;
+	dnsSecondTick = schedulerTicks();
+	dnsSeed ^= dnsSecondTick;//differs between boots as long as the startup time does
+	dnsFlush();
+}
+
+void dnsFlush(void)
+{
+	unsigned char i;
+	
+	for(i=0; i<DNS_CACHE_SIZE; i++)	dnsCache[i].state = DNS_ENTRY_EMPTY;
+}
+
+void dnsClock(void)//called at least every 65 s by dnsTask
+{
+	while(TICKS_ELAPSED(dnsSecondTick) >= 1000)
+	{
+		dnsSecondTick += 1000;
+		dnsSeconds++;
+	}
+}
+
+//xorshift32 stirred with the tick count of every call - IDs and ports are hard to guess off-path, not cryptographic
+unsigned int dnsRandom(void)
+{
+	dnsSeed ^= schedulerTicks();
+	if(dnsSeed == 0)	dnsSeed = 0x2545F491;
+	dnsSeed ^= dnsSeed << 13;
+	dnsSeed ^= dnsSeed >> 17;
+	dnsSeed ^= dnsSeed << 5;
+	
+	return (unsigned int)(dnsSeed >> 16);
+}
+
+unsigned char dnsWaiting(void)//YES if some query waits for its answer
+{
+	unsigned char i;
+	
+	for(i=0; i<DNS_CACHE_SIZE; i++)
+	{
+		if(dnsCache[i].state == DNS_ENTRY_WAITING)	return YES;
+	}
+	
+	return NO;
+}
+
+unsigned int dnsWord(const unsigned char data[])//big endian
+{
+	return ((unsigned int)data[0] << 8) | data[1];
+}
+
+//"a.bc" and "a.bc." -> 1 a 2 b c 0, returns bytes written, FAIL for an empty label or one longer than DNS_LABEL_MAX
+unsigned char dnsEncodeName(unsigned char buffer[], const char name[])
+{
+	unsigned char length = 0, label = 0;
+	
+	buffer[0] = 0;
+	while(*name)
+	{
+		if(*name == '.')
+		{
+			if(length == label)	return FAIL;//".a", "a..b"
+			buffer[label] = length - label;
+			if(name[1] == '\0')//trailing dot of a fully qualified name
+			{
+				buffer[length + 1] = 0;
+				return length + 2;
+			}
+			label = length + 1;
+		}
+		else
+		{
+			if(length - label >= DNS_LABEL_MAX)	return FAIL;
+			buffer[length + 1] = *name;
+		}
+		length++;
+		name++;
+	}
+	if(length == label)	return FAIL;//empty name
+	buffer[label] = length - label;
+	buffer[length + 1] = 0;
+	
+	return length + 2;
+}
+
+//returns offset after the name or 0 if it does not fit into the message
+unsigned int dnsSkipName(const unsigned char message[], unsigned int length, unsigned int offset)
+{
+	while(offset < length)
+	{
+		if(message[offset] == 0)	return offset + 1;
+		if((message[offset] & 0xC0) == 0xC0)	return offset + 2;//compression pointer ends the name
+		offset += 1 + message[offset];
+	}
+	
+	return 0;
+}
+
+dnsCacheEntry *dnsFind(const char name[])
+{
+	unsigned char i;
+	
+	for(i=0; i<DNS_CACHE_SIZE; i++)
+	{
+		if(dnsCache[i].state != DNS_ENTRY_EMPTY && strcmp(dnsCache[i].name, name) == 0)	return &dnsCache[i];
+	}
+	
+	return 0;
+}
+
+dnsCacheEntry *dnsAllocate(void)//empty entry, otherwise the answer closest to expiry
+{
+	dnsCacheEntry *entry = 0;
+	unsigned char i;
+	
+	for(i=0; i<DNS_CACHE_SIZE; i++)
+	{
+		if(dnsCache[i].state == DNS_ENTRY_EMPTY)	return &dnsCache[i];
+		if(dnsCache[i].state == DNS_ENTRY_QUERY || dnsCache[i].state == DNS_ENTRY_WAITING)	continue;
+		if(!entry || dnsCache[i].expires < entry->expires)	entry = &dnsCache[i];
+	}
+	
+	return entry;
+}
+
+unsigned char dnsResolve(const char name[], address *ip)
+{
+	dnsCacheEntry *entry;
+	unsigned char encoded[DNS_NAME_SIZE + 1];
+	
+	if(strlen(name) >= DNS_NAME_SIZE || dnsEncodeName(encoded, name) == FAIL)	return DNS_FAILED;//no query for a name the server cannot parse
+	dnsClock();
+	
+	entry = dnsFind(name);
+	if(entry)
+	{
+		if(entry->state == DNS_ENTRY_QUERY || entry->state == DNS_ENTRY_WAITING)	return DNS_PENDING;
+		if(dnsSeconds < entry->expires)
+		{
+			if(entry->state == DNS_ENTRY_FAILED)	return DNS_FAILED;//negative caching
+			*ip = entry->ip;
+			return DNS_RESOLVED;
+		}
+	}
+	else
+	{
+		entry = dnsAllocate();
+		if(!entry)	return DNS_PENDING;//every entry has a query running, try again later
+		strcpy(entry->name, name);
+	}
+	
+	entry->state = DNS_ENTRY_QUERY;//sent by dnsTask
+	entry->retries = 0;
+	
+	return DNS_PENDING;
+}
+
+void dnsSendQuery(dnsCacheEntry *entry)
+{
+	unsigned char query[DNS_HEADER_SIZE + DNS_NAME_SIZE + 1 + 4];
+	unsigned char length;
+	unsigned int id = dnsRandom();
+	
+	entry->id[entry->retries] = id;
+	memset(query, 0, DNS_HEADER_SIZE);
+	query[0] = id >> 8;
+	query[1] = id & 0xFF;
+	query[2] = 0x01;//recursion desired
+	query[5] = 1;//one question
+	length = DNS_HEADER_SIZE + dnsEncodeName(query + DNS_HEADER_SIZE, entry->name);
+	query[length++] = 0;
+	query[length++] = DNS_TYPE_A;
+	query[length++] = 0;
+	query[length++] = DNS_CLASS_IN;
+	
+	ethernetSendDataTo(dnsSocket, dnsServer, (char *)query, length);
+	entry->state = DNS_ENTRY_WAITING;
+	entry->sent = schedulerTicks();
+	entry->retries++;
+}
+
+unsigned char dnsSendQueries(void)//OK if something was sent
+{
+	unsigned char i, sent = FAIL;
+	dnsCacheEntry *entry;
+	
+	for(i=0; i<DNS_CACHE_SIZE; i++)
+	{
+		entry = &dnsCache[i];
+		if(entry->state == DNS_ENTRY_WAITING && TICKS_ELAPSED(entry->sent) >= DNS_RETRY_TIMEOUT)
+		{
+			if(entry->retries >= DNS_RETRIES)
+			{
+				dnsAnswer(entry, NO, 0, DNS_NEGATIVE_TTL);//server does not answer
+				continue;
+			}
+			entry->state = DNS_ENTRY_QUERY;
+		}
+		if(entry->state != DNS_ENTRY_QUERY)	continue;
+		
+		if(ethernetGetStatus(dnsSocket) != SOCK_UDP || (entry->retries == 0 && dnsWaiting() == NO))//new port for a new lookup, retries keep it for late answers
+		{
+			ethernetSocketClose(dnsSocket);
+			if(ethernetSocketOpenUDP(dnsSocket, DNS_SOURCE_PORT_MIN + dnsRandom() % DNS_SOURCE_PORTS) == FAIL)	return sent;
+		}
+		dnsSendQuery(entry);
+		sent = OK;
+	}
+	
+	return sent;
+}
+
+void dnsAnswer(dnsCacheEntry *entry, unsigned char resolved, const unsigned char ip[], unsigned long ttl)
+{
+	if(resolved)
+	{
+		entry->ip.b0 = ip[0];
+		entry->ip.b1 = ip[1];
+		entry->ip.b2 = ip[2];
+		entry->ip.b3 = ip[3];
+		if(ttl < DNS_MIN_TTL)	ttl = DNS_MIN_TTL;
+		if(ttl > DNS_MAX_TTL)	ttl = DNS_MAX_TTL;
+	}
+	entry->state = resolved ? DNS_ENTRY_RESOLVED : DNS_ENTRY_FAILED;
+	entry->expires = dnsSeconds + ttl;
+}
+
+void dnsReceive(void)
+{
+	unsigned char message[DNS_MESSAGE_SIZE];
+	unsigned char name[DNS_NAME_SIZE + 1];
+	IPaddressAndPort source;
+	dnsCacheEntry *entry = 0;
+	unsigned int length, offset, answers, rdLength;
+	unsigned long ttl, minTTL = DNS_MAX_TTL;
+	unsigned char nameLength, i, j, found = NO;
+	
+	length = ethernetSocketReceiveDatagram(dnsSocket, &source, (char *)message, DNS_MESSAGE_SIZE);
+	if(length < DNS_HEADER_SIZE || source.socketPort != DNS_PORT)	return;
+	if(source.b0 != dnsServer.b0 || source.b1 != dnsServer.b1 || source.b2 != dnsServer.b2 || source.b3 != dnsServer.b3)	return;
+	if(!(message[2] & 0x80) || dnsWord(message + 4) != 1)	return;//not a response to one question
+	
+	for(i=0; i<DNS_CACHE_SIZE; i++)
+	{
+		if(dnsCache[i].state != DNS_ENTRY_WAITING)	continue;
+		for(j=0; j<dnsCache[i].retries; j++)
+		{
+			if(dnsCache[i].id[j] == dnsWord(message))	entry = &dnsCache[i];//answer to any attempt, the server may just be slow
+		}
+	}
+	if(!entry)	return;//not ours
+	
+	nameLength = dnsEncodeName(name, entry->name);//question must be the one we asked
+	offset = DNS_HEADER_SIZE + nameLength + 4;
+	if(offset > length || memcmp(message + DNS_HEADER_SIZE, name, nameLength) != 0)	return;
+	
+	if((message[3] & 0x0F) != 0)//NXDOMAIN, SERVFAIL, REFUSED
+	{
+		dnsAnswer(entry, NO, 0, DNS_NEGATIVE_TTL);
+		return;
+	}
+	
+	//first A record, CNAMEs in front of it are skipped, the shortest TTL of the chain is used
+	for(answers = dnsWord(message + 6); answers; answers--)
+	{
+		offset = dnsSkipName(message, length, offset);
+		if(offset == 0 || offset + 10 > length)	break;
+		ttl = ((unsigned long)dnsWord(message + offset + 4) << 16) | dnsWord(message + offset + 6);
+		rdLength = dnsWord(message + offset + 8);
+		if(offset + 10 + rdLength > length)	break;
+		if(ttl < minTTL)	minTTL = ttl;
+		if(dnsWord(message + offset) == DNS_TYPE_A && dnsWord(message + offset + 2) == DNS_CLASS_IN && rdLength == 4)
+		{
+			found = YES;
+			break;
+		}
+		offset += 10 + rdLength;
+	}
+	
+	if(found)	dnsAnswer(entry, YES, message + offset + 10, minTTL);
+	else		dnsAnswer(entry, NO, 0, DNS_NEGATIVE_TTL);//NODATA
+}
+
+unsigned char dnsTask(task *t)
+{
+	unsigned char busy = 0;
+	
+	TASK_BEGIN(t);
+	while(1)
+	{
+		dnsClock();
+		
+		if(dnsWaiting() == YES && ethernetCheckIfReceivedData(dnsSocket) == OK)//socket is read only while an answer is expected
+		{
+			dnsReceive();
+			busy = 1;
+		}
+		if(dnsSendQueries() == OK)	busy = 1;
+		
+		if(busy)
+		{
+			TASK_YIELD(t);
+		}
+		else
+		{
+			TASK_POLL(t);
+		}
+	}
+	TASK_END(t);
+}
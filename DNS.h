@@ -0,0 +1,77 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   DNS resolver for Wiznet W5500 library for AVR XMEGA
+ * @verbatim
+	Non-blocking A record lookups over UDP, fixed size cache honoring TTLs, negative caching
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#ifndef DNS_H_
+#define DNS_H_
+
+#define DNS_PORT					53
+#define DNS_SOURCE_PORT_MIN			49152	//random source port per lookup from the dynamic range
+#define DNS_SOURCE_PORTS			16384
+#define DNS_CACHE_SIZE				4
+#define DNS_NAME_SIZE				48	//longest host name + 1
+#define DNS_MESSAGE_SIZE			512	//longest response read, the rest of a longer one is dropped
+#define DNS_RETRY_TIMEOUT			1000	//ms without answer before the query is sent again
+#define DNS_RETRIES					3
+#define DNS_MIN_TTL					10	//s, lower TTLs are raised so a zero TTL does not cost a query per connect
+#define DNS_MAX_TTL					86400UL	//s
+#define DNS_NEGATIVE_TTL			60	//s, NXDOMAIN, no A record, server error or no answer at all
+
+//dnsResolve results, DNS_FAILED == FAIL and DNS_RESOLVED == OK
+#define DNS_FAILED					0
+#define DNS_RESOLVED				1
+#define DNS_PENDING					2
+
+//dnsCacheEntry.state
+#define DNS_ENTRY_EMPTY				0
+#define DNS_ENTRY_QUERY				1	//query not sent yet
+#define DNS_ENTRY_WAITING			2	//query sent, waiting for the answer
+#define DNS_ENTRY_RESOLVED			3
+#define DNS_ENTRY_FAILED			4
+
+
+typedef struct structure12
+{
+	char name[DNS_NAME_SIZE];
+	address ip;
+	unsigned char state;
+	unsigned char retries;
+	unsigned int id[DNS_RETRIES];//of every query sent, an answer to any of them is taken
+	unsigned int sent;//schedulerTicks() of the last query
+	unsigned long expires;//dnsSeconds of the end of TTL
+}dnsCacheEntry;
+
+
+//Public prototypes
+
+//dnsInit(SOC7_REG, dnsServer); schedulerAdd(&dnsTaskData, dnsTask, NULL);
+//dnsResolve() never blocks, call it again until it is not DNS_PENDING - answers are cached for their TTL
+
+void dnsInit(unsigned char socket, address server);//UDP socket for queries, DNS server (usually the gateway)
+unsigned char dnsResolve(const char name[], address *ip);//DNS_RESOLVED with ip filled in, DNS_PENDING, DNS_FAILED
+void dnsFlush(void);//forget every cached answer, e.g. after the network changed
+unsigned char dnsTask(task *t);//arg unused, sends queries and reads answers, no SPI traffic while nothing is pending
+
+#endif /* DNS_H_ */
@@ -0,0 +1,149 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   Binary framed command protocol for Wiznet W5500 library for AVR XMEGA
+ * @verbatim
+	Length, opcode and sequence number header, CRC-16, command dispatch table, pipelined requests
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+#include "W5500.h"
+#include "Frame.h"
+
+
+//Private prototypes
+
+unsigned int frameWord(const unsigned char data[]);
+unsigned int frameCRC(const unsigned char data[], unsigned int length);
+unsigned char framePing(const unsigned char request[], unsigned int length, unsigned char response[], unsigned int *responseLength);
+unsigned char frameHello(const unsigned char request[], unsigned int length, unsigned char response[], unsigned int *responseLength);
+unsigned int frameRequestLength(const unsigned char header[]);
+unsigned int frameProcess(const unsigned char frame[], unsigned int frameLength, unsigned char response[]);
+
+
+//Command dispatch table, searched in order
+static const frameCommand frameCommands[] PROGMEM =
+{
+	{FRAME_PING, framePing},
+	{FRAME_HELLO, frameHello},
+};
+
+
+unsigned int frameWord(const unsigned char data[])//big endian
+{
+	return ((unsigned int)data[0] << 8) | data[1];
+}
+
+unsigned int frameCRC(const unsigned char data[], unsigned int length)//CRC-16/CCITT-FALSE
+{
+	unsigned int crc = 0xFFFF, i;
+	
+	for(i=0; i<length; i++)	crc = _crc_xmodem_update(crc, data[i]);
+	
+	return crc;
+}
+
+unsigned char framePing(const unsigned char request[], unsigned int length, unsigned char response[], unsigned int *responseLength)
+{
+	unsigned int i;
+	
+	if(length > FRAME_PAYLOAD_SIZE - 1)	return FRAME_BAD_LENGTH;//no room for the status byte
+	for(i=0; i<length; i++)	response[i] = request[i];
+	*responseLength = length;
+	
+	return FRAME_OK;
+}
+
+unsigned char frameHello(const unsigned char request[], unsigned int length, unsigned char response[], unsigned int *responseLength)
+{
+	static const char hello[] PROGMEM = "HELLO 2 YOU!";
+	
+	if(length != 0)	return FRAME_BAD_LENGTH;
+	memcpy_P(response, hello, sizeof(hello) - 1);
+	*responseLength = sizeof(hello) - 1;
+	
+	return FRAME_OK;
+}
+
+unsigned int frameRequestLength(const unsigned char header[])
+{
+	unsigned int payloadLength = frameWord(header + 1);
+	
+	if(header[0] != FRAME_SYNC || payloadLength > FRAME_PAYLOAD_SIZE)	return 0;//lost framing
+	
+	return FRAME_HEADER_SIZE + payloadLength + FRAME_CRC_SIZE;
+}
+
+//frame = complete request, response = room for FRAME_SIZE bytes, returns length of the response frame
+unsigned int frameProcess(const unsigned char frame[], unsigned int frameLength, unsigned char response[])
+{
+	unsigned char status = FRAME_UNKNOWN_OPCODE, i;
+	unsigned int payloadLength = frameLength - FRAME_HEADER_SIZE - FRAME_CRC_SIZE;
+	unsigned int length = 0, crc;
+	frameCommand command;
+	
+	if(frameWord(frame + FRAME_HEADER_SIZE + payloadLength) != frameCRC(frame + 1, FRAME_HEADER_SIZE - 1 + payloadLength))
+	{
+		status = FRAME_BAD_CRC;
+	}
+	else
+	{
+		for(i=0; i<sizeof(frameCommands) / sizeof(frameCommands[0]); i++)
+		{
+			memcpy_P(&command, &frameCommands[i], sizeof(frameCommand));
+			if(command.opcode == frame[3])
+			{
+				status = command.handler(frame + FRAME_HEADER_SIZE, payloadLength, response + FRAME_HEADER_SIZE + 1, &length);
+				break;
+			}
+		}
+	}
+	if(status != FRAME_OK)	length = 0;
+	
+	length += 1;//status
+	response[0] = FRAME_SYNC;
+	response[1] = length >> 8;
+	response[2] = length & 0xFF;
+	response[3] = frame[3] | FRAME_RESPONSE;
+	response[4] = frame[4];//sequence
+	response[5] = frame[5];
+	response[6] = status;
+	crc = frameCRC(response + 1, FRAME_HEADER_SIZE - 1 + length);
+	response[FRAME_HEADER_SIZE + length] = crc >> 8;
+	response[FRAME_HEADER_SIZE + length + 1] = crc & 0xFF;
+	
+	return FRAME_HEADER_SIZE + length + FRAME_CRC_SIZE;
+}
+
+unsigned char frameWaiting(unsigned char socket)
+{
+	//first byte at the read pointer only, text commands go on to ethernetSocketReceiveData untouched
+	if(ethernetRXdata8(ethernetRXdata16(Sn_RX_RD_L, socket), socket + 2) == FRAME_SYNC)	return YES;//+2 to get RXBUF
+	
+	return NO;
+}
+
+unsigned char frameReceive(unsigned char socket)
+{
+	return ethernetSocketReceivePipelined(socket, FRAME_HEADER_SIZE + FRAME_CRC_SIZE, FRAME_SIZE, frameRequestLength, frameProcess);//empty payload is the shortest request
+}
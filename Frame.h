@@ -0,0 +1,65 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   Binary framed command protocol for Wiznet W5500 library for AVR XMEGA
+ * @verbatim
+	Length, opcode and sequence number header, CRC-16, command dispatch table, pipelined requests
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#ifndef FRAME_H_
+#define FRAME_H_
+
+//Frame, multi byte fields big endian:
+//sync 0xA5 | payload length (2) | opcode (1) | sequence (2) | payload | CRC-16/CCITT-FALSE (2) of everything after sync
+//Response: same sequence, opcode | FRAME_RESPONSE, payload = status + data
+
+#define FRAME_SYNC					0xA5	//cannot start a text command or an HTTP request
+#define FRAME_HEADER_SIZE			6
+#define FRAME_CRC_SIZE				2
+#define FRAME_PAYLOAD_SIZE			250	//longest payload in both directions
+#define FRAME_SIZE					(FRAME_HEADER_SIZE + FRAME_PAYLOAD_SIZE + FRAME_CRC_SIZE)	//pipelined requests share PIPELINE_BUFFER_SIZE
+#define FRAME_RESPONSE				0x80
+
+//opcodes 0x00 - 0x7F, application commands are added to frameCommands[] (flash) in Frame.c
+#define FRAME_PING					0x01	//payload echoed back
+#define FRAME_HELLO					0x02	//binary twin of the HELLO text command
+
+//status, first byte of every response payload
+#define FRAME_OK					0x00
+#define FRAME_UNKNOWN_OPCODE		0x01
+#define FRAME_BAD_LENGTH			0x02
+#define FRAME_BAD_CRC				0x03	//request not executed, framing kept
+
+
+typedef struct structure14
+{
+	unsigned char opcode;
+	unsigned char (*handler)(const unsigned char request[], unsigned int length, unsigned char response[], unsigned int *responseLength);//returns status, up to FRAME_PAYLOAD_SIZE - 1 response bytes
+}frameCommand;
+
+
+//Public prototypes
+
+//TCPserver/TCPserverTask hand a connection to frameReceive when its data starts with FRAME_SYNC, it stays open for further requests
+unsigned char frameWaiting(unsigned char socket);//YES if the data waiting in RX starts with FRAME_SYNC, call only when ethernetCheckIfReceivedData is OK
+unsigned char frameReceive(unsigned char socket);//all complete requests waiting in RX, CONNECTION_CLOSE on broken framing, CONNECTION_PARTIAL if none was complete
+
+#endif /* FRAME_H_ */
@@ -0,0 +1,397 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   HTTP helpers for Wiznet W5500 library for AVR XMEGA
+ * @verbatim
+	Streaming HTTP POST with JSON body - Content-Length patched in the TX buffer
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <avr/pgmspace.h>
+#include "W5500.h"
+#include "HTTP.h"
+
+
+//Private prototypes
+
+void jsonKey(const char key[]);
+void jsonEscaped(char data);
+void jsonDecimal(unsigned long value, unsigned char minDigits);
+void httpStatusLine(httpResponse *response);
+void httpHeaderLine(httpResponse *response);
+void httpHeadersEnd(httpResponse *response);
+void httpBodyByte(httpResponse *response, char data);
+
+
+static unsigned int contentLengthPosition;//first byte of the reserved Content-Length field
+static unsigned int bodyPosition;
+static unsigned char jsonFirst;
+
+
+unsigned char httpPostBegin(unsigned char socket, const char path[], const char host[])
+{
+	unsigned char i;
+	
+	if(ethernetStreamBegin(socket) == FAIL)	return FAIL;
+	
+	ethernetStreamText(PSTR("POST "));
+	ethernetStreamText(path);
+	ethernetStreamText(PSTR(" HTTP/1.1\r\nHost: "));
+	ethernetStreamText(host);
+	ethernetStreamText(PSTR("\r\nContent-Type: application/json\r\nContent-Length:"));
+	contentLengthPosition = ethernetStreamPosition();
+	for(i=0; i<HTTP_CONTENT_LENGTH_DIGITS; i++)	ethernetStreamByte(' ');//patched in httpPostEnd, leading spaces are allowed whitespace
+	ethernetStreamText(PSTR("\r\n\r\n{"));
+	bodyPosition = ethernetStreamPosition() - 1;
+	jsonFirst = 1;
+	
+	return OK;
+}
+
+void jsonKey(const char key[])
+{
+	if(!jsonFirst)	ethernetStreamByte(',');
+	jsonFirst = 0;
+	
+	ethernetStreamByte('"');
+	ethernetStreamText(key);
+	ethernetStreamText(PSTR("\":"));
+}
+
+void jsonEscaped(char data)
+{
+	if(data == '"' || data == '\\')
+	{
+		ethernetStreamByte('\\');
+		ethernetStreamByte(data);
+	}
+	else if((unsigned char)data < 0x20)//control characters
+	{
+		ethernetStreamText(PSTR("\\u00"));
+		ethernetStreamByte("0123456789abcdef"[(data >> 4) & 0x0F]);
+		ethernetStreamByte("0123456789abcdef"[data & 0x0F]);
+	}
+	else
+	{
+		ethernetStreamByte(data);
+	}
+}
+
+void jsonDecimal(unsigned long value, unsigned char minDigits)
+{
+	char digits[20];
+	unsigned char i = 0;
+	
+	do
+	{
+		digits[i++] = '0' + (value % 10);
+		value /= 10;
+	}while(value || i < minDigits);
+	
+	while(i)	ethernetStreamByte(digits[--i]);
+}
+
+void jsonString(const char key[], const char value[])
+{
+	jsonKey(key);
+	ethernetStreamByte('"');
+	while(pgm_read_byte(value))
+	{
+		jsonEscaped(pgm_read_byte(value++));
+	}
+	ethernetStreamByte('"');
+}
+
+void jsonStringRAM(const char key[], const char value[])
+{
+	jsonKey(key);
+	ethernetStreamByte('"');
+	while(*value)
+	{
+		jsonEscaped(*value++);
+	}
+	ethernetStreamByte('"');
+}
+
+void jsonInteger(const char key[], long value)
+{
+	jsonKey(key);
+	if(value < 0)
+	{
+		ethernetStreamByte('-');
+		jsonDecimal(-(unsigned long)value, 1);
+	}
+	else
+	{
+		jsonDecimal(value, 1);
+	}
+}
+
+void jsonFixed(const char key[], long value, unsigned char decimals)
+{
+	unsigned long magnitude, scale = 1;
+	unsigned char i;
+	
+	magnitude = (value < 0) ? -(unsigned long)value : (unsigned long)value;
+	for(; decimals > JSON_FIXED_DECIMALS; decimals--)	magnitude /= 10;//same number, least significant digits dropped
+	for(i=0; i<decimals; i++)	scale *= 10;
+	
+	jsonKey(key);
+	if(value < 0)	ethernetStreamByte('-');
+	jsonDecimal(magnitude / scale, 1);
+	if(decimals)
+	{
+		ethernetStreamByte('.');
+		jsonDecimal(magnitude % scale, decimals);
+	}
+}
+
+unsigned char httpPostEnd(void)
+{
+	char field[HTTP_CONTENT_LENGTH_DIGITS];
+	unsigned int length;
+	unsigned char i;
+	
+	ethernetStreamByte('}');
+	length = ethernetStreamPosition() - bodyPosition;
+	
+	for(i=HTTP_CONTENT_LENGTH_DIGITS; i>0; i--)//right aligned, spaces in front
+	{
+		field[i-1] = (length || i == HTTP_CONTENT_LENGTH_DIGITS) ? ('0' + (length % 10)) : ' ';
+		length /= 10;
+	}
+	ethernetStreamPatch(contentLengthPosition, field, HTTP_CONTENT_LENGTH_DIGITS);
+	
+	return ethernetStreamEnd();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+//Response parser
+
+void httpResponseInit(httpResponse *response)
+{
+	response->state = HTTP_STATUS_LINE;
+	response->status = 0;
+	response->keepAlive = 1;//HTTP/1.1 default
+	response->chunked = 0;
+	response->truncated = 0;
+	response->contentLength = HTTP_LENGTH_UNKNOWN;
+	response->remaining = 0;
+	response->lineLength = 0;
+	response->bodyLength = 0;
+	response->body[0] = '\0';
+}
+
+char *httpHeaderValue(char line[], const char name[])//name in flash, lower case, without ':'
+{
+	while(pgm_read_byte(name))
+	{
+		if(tolower((unsigned char)*line++) != pgm_read_byte(name++))	return 0;
+	}
+	if(*line++ != ':')	return 0;
+	while(*line == ' ' || *line == '\t')	line++;
+	
+	return line;
+}
+
+char *httpRequestHeader(char request[], const char name[])
+{
+	char *line = strstr(request, "\r\n");//skip the request line
+	char *value;
+	
+	while(line && line[2] != '\r' && line[2] != '\0')//empty line ends the headers
+	{
+		line += 2;
+		if((value = httpHeaderValue(line, name)))	return value;
+		line = strstr(line, "\r\n");
+	}
+	return 0;
+}
+
+unsigned char httpContains(char value[], const char token[])//case insensitive, token in flash, lower case
+{
+	unsigned char i;
+	
+	for(; *value && *value != '\r'; value++)//value of a request header ends with the line
+	{
+		for(i=0; pgm_read_byte(token + i) && tolower((unsigned char)value[i]) == pgm_read_byte(token + i); i++);
+		if(pgm_read_byte(token + i) == '\0')	return YES;
+	}
+	return NO;
+}
+
+void httpStatusLine(httpResponse *response)
+{
+	if(response->lineLength == 0)	return;//tolerate empty lines before the status line
+	if(response->lineLength < 12 || strncmp(response->line, "HTTP/1.", 7) != 0 || response->line[8] != ' ')//"HTTP/1.1 200"
+	{
+		response->state = HTTP_ERROR;
+		return;
+	}
+	if(response->line[7] == '0')	response->keepAlive = 0;//HTTP/1.0 closes unless asked otherwise
+	
+	response->status = strtoul(response->line + 9, 0, 10);
+	response->state = HTTP_HEADER_LINE;
+}
+
+void httpHeaderLine(httpResponse *response)
+{
+	char *value;
+	
+	if(response->lineLength == 0)
+	{
+		httpHeadersEnd(response);
+	}
+	else if((value = httpHeaderValue(response->line, PSTR("content-length"))))
+	{
+		response->contentLength = strtoul(value, 0, 10);
+	}
+	else if((value = httpHeaderValue(response->line, PSTR("transfer-encoding"))))
+	{
+		response->chunked = httpContains(value, PSTR("chunked"));
+	}
+	else if((value = httpHeaderValue(response->line, PSTR("connection"))))
+	{
+		if(httpContains(value, PSTR("close")))	response->keepAlive = 0;
+		else if(httpContains(value, PSTR("keep-alive")))	response->keepAlive = 1;
+	}
+}
+
+void httpHeadersEnd(httpResponse *response)
+{
+	if(response->status >= 100 && response->status < 200)//100 Continue, the real response follows
+	{
+		httpResponseInit(response);
+	}
+	else if(response->status == 204 || response->status == 304)//never have a body
+	{
+		response->state = HTTP_COMPLETE;
+	}
+	else if(response->chunked)
+	{
+		response->state = HTTP_CHUNK_SIZE;
+	}
+	else if(response->contentLength != HTTP_LENGTH_UNKNOWN)
+	{
+		response->remaining = response->contentLength;
+		response->state = response->remaining ? HTTP_BODY : HTTP_COMPLETE;
+	}
+	else
+	{
+		response->keepAlive = 0;//only FIN tells where the body ends
+		response->state = HTTP_BODY_UNTIL_CLOSE;
+	}
+}
+
+void httpBodyByte(httpResponse *response, char data)
+{
+	if(response->bodyLength < HTTP_BODY_SIZE - 1)
+	{
+		response->body[response->bodyLength++] = data;
+		response->body[response->bodyLength] = '\0';
+	}
+	else
+	{
+		response->truncated = 1;
+	}
+}
+
+unsigned char httpResponseByte(void *context, char data)
+{
+	httpResponse *response = context;
+	
+	switch(response->state)
+	{
+		case HTTP_BODY:
+			httpBodyByte(response, data);
+			if(--response->remaining == 0)	response->state = HTTP_COMPLETE;
+			break;
+		
+		case HTTP_BODY_UNTIL_CLOSE:
+			httpBodyByte(response, data);
+			break;
+		
+		case HTTP_CHUNK_DATA:
+			httpBodyByte(response, data);
+			if(--response->remaining == 0)	response->state = HTTP_CHUNK_DATA_END;
+			break;
+		
+		case HTTP_COMPLETE:
+		case HTTP_ERROR:
+			return FAIL;
+		
+		default://line based states
+			if(data == '\r')	break;
+			if(data != '\n')
+			{
+				if(response->lineLength < HTTP_LINE_SIZE - 1)	response->line[response->lineLength++] = data;
+				break;
+			}
+			response->line[response->lineLength] = '\0';
+			
+			switch(response->state)
+			{
+				case HTTP_STATUS_LINE: httpStatusLine(response); break;
+				case HTTP_HEADER_LINE: httpHeaderLine(response); break;
+				case HTTP_CHUNK_SIZE:
+					if(!isxdigit((unsigned char)response->line[0]))
+					{
+						response->state = HTTP_ERROR;
+						break;
+					}
+					response->remaining = strtoul(response->line, 0, 16);//stops at ';' of chunk extensions
+					response->state = response->remaining ? HTTP_CHUNK_DATA : HTTP_TRAILER;
+					break;
+				case HTTP_CHUNK_DATA_END:
+					response->state = (response->lineLength == 0) ? HTTP_CHUNK_SIZE : HTTP_ERROR;
+					break;
+				case HTTP_TRAILER:
+					if(response->lineLength == 0)	response->state = HTTP_COMPLETE;
+					break;
+			}
+			response->lineLength = 0;
+			break;
+	}
+	
+	return (response->state == HTTP_COMPLETE || response->state == HTTP_ERROR) ? FAIL : OK;
+}
+
+unsigned char httpResponseReceive(unsigned char socket, httpResponse *response)
+{
+	if(response->state != HTTP_COMPLETE && response->state != HTTP_ERROR)
+	{
+		ethernetSocketReceiveStream(socket, httpResponseByte, response);
+	}
+	return response->state;
+}
+
+unsigned char httpResponseClosed(httpResponse *response)
+{
+	if(response->state == HTTP_BODY_UNTIL_CLOSE)	response->state = HTTP_COMPLETE;
+	else if(response->state != HTTP_COMPLETE)	response->state = HTTP_ERROR;//connection closed in the middle
+	response->keepAlive = 0;
+	
+	return response->state;
+}
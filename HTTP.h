@@ -0,0 +1,94 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   HTTP helpers for Wiznet W5500 library for AVR XMEGA
+ * @verbatim
+	Streaming HTTP POST with JSON body - Content-Length patched in the TX buffer
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#ifndef HTTP_H_
+#define HTTP_H_
+
+#define HTTP_CONTENT_LENGTH_DIGITS	5	//room reserved for Content-Length value, max 99999 bytes of body
+#define HTTP_LINE_SIZE				48	//status line and header lines are cut to this size, enough for the headers we look at
+#define HTTP_BODY_SIZE				128	//longer bodies are consumed but truncated, see httpResponse.truncated
+#define JSON_FIXED_DECIMALS			9	//jsonFixed, 10^9 is the largest power of ten in 32 bits
+
+#define HTTP_LENGTH_UNKNOWN			0xFFFFFFFFUL
+
+//httpResponse.state
+#define HTTP_STATUS_LINE			0
+#define HTTP_HEADER_LINE			1
+#define HTTP_BODY					2	//Content-Length bytes
+#define HTTP_BODY_UNTIL_CLOSE		3	//no length, body ends with FIN
+#define HTTP_CHUNK_SIZE				4
+#define HTTP_CHUNK_DATA				5
+#define HTTP_CHUNK_DATA_END			6	//CRLF after chunk data
+#define HTTP_TRAILER				7
+#define HTTP_COMPLETE				8
+#define HTTP_ERROR					9
+
+
+typedef struct structure9
+{
+	unsigned char state;
+	unsigned int status;//200, 404, ...
+	unsigned char keepAlive;//connection can be reused after HTTP_COMPLETE
+	unsigned char chunked;
+	unsigned char truncated;//body did not fit into body[]
+	unsigned long contentLength;//HTTP_LENGTH_UNKNOWN if not sent
+	unsigned long remaining;//body or chunk bytes still to come
+	unsigned char lineLength;
+	char line[HTTP_LINE_SIZE];
+	unsigned int bodyLength;
+	char body[HTTP_BODY_SIZE];//always '\0' terminated
+}httpResponse;
+
+
+//Public prototypes
+
+//JSON POST request written straight into the socket TX buffer, nothing is buffered in RAM
+//httpPostBegin(socket, PSTR("/path"), PSTR("host"));
+//jsonString(PSTR("key"), PSTR("value")); jsonInteger(PSTR("count"), 42); jsonFixed(PSTR("temp"), 2154, 2);
+//httpPostEnd(); - closes the object, fills in Content-Length and sends, FAIL if the request did not fit
+
+unsigned char httpPostBegin(unsigned char socket, const char path[], const char host[]);//path and host in flash
+void jsonString(const char key[], const char value[]);//key and value in flash
+void jsonStringRAM(const char key[], const char value[]);//key in flash, value in RAM
+void jsonInteger(const char key[], long value);
+void jsonFixed(const char key[], long value, unsigned char decimals);//value 2154, decimals 2 -> 21.54, digits past JSON_FIXED_DECIMALS are cut off
+unsigned char httpPostEnd(void);
+
+//Response parser, fed straight from the socket RX buffer, keeps its state between receives
+//stops at the end of a response, so bytes of the next (pipelined) response stay in the RX buffer
+
+void httpResponseInit(httpResponse *response);
+unsigned char httpResponseByte(void *response, char data);//OK to continue, FAIL when response is complete or broken
+unsigned char httpResponseReceive(unsigned char socket, httpResponse *response);//returns httpResponse.state
+unsigned char httpResponseClosed(httpResponse *response);//FIN received, returns httpResponse.state
+
+//Header fields, names case insensitive (RFC 7230)
+
+char *httpHeaderValue(char line[], const char name[]);//name in flash, lower case, without ':', value or 0 if the line is another header
+char *httpRequestHeader(char request[], const char name[]);//same for a whole request in RAM, value ends with "\r\n"
+unsigned char httpContains(char value[], const char token[]);//YES if the value contains the token, case insensitive, token in flash, lower case
+
+#endif /* HTTP_H_ */
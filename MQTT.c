@@ -0,0 +1,458 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   MQTT 3.1.1 client for Wiznet W5500 library for AVR XMEGA
+ * @verbatim
+	Persistent session, keep alive, QoS 0/1 publish, subscribe, publishes coalesced into one SEND
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "W5500.h"
+#include "MQTT.h"
+
+#define MQTT_CLIENT_ID_SIZE		23	//longest client id every 3.1.1 broker has to accept
+
+
+//Private prototypes
+
+unsigned char mqttEncodeLength(unsigned char buffer[], unsigned int length);
+unsigned int mqttPacketLength(const unsigned char packet[], unsigned int available, unsigned char *headerLength);
+unsigned char mqttQueueSubscribe(mqttClient *client, const char topic[], unsigned char qos);
+unsigned char mqttQueuePacket(mqttClient *client, unsigned char type, unsigned int packetId);
+void mqttSendConnect(mqttClient *client);
+void mqttResendInflight(mqttClient *client);
+void mqttConnectionLost(mqttClient *client);
+void mqttRemoveInflight(mqttClient *client, unsigned int packetId);
+unsigned char mqttPacket(mqttClient *client, unsigned char packet[], unsigned char headerLength, unsigned int length);
+unsigned char mqttReceive(mqttClient *client);
+unsigned char mqttFlush(mqttClient *client);
+
+
+void mqttInit(mqttClient *client, unsigned char socket, unsigned int sourceSocketPort, IPaddressAndPort server, const char clientId[], unsigned int keepAlive, void (*received)(const char topic[], unsigned int topicLength, const char payload[], unsigned int length))
+{
+	client->socket = socket;
+	client->sourceSocketPort = sourceSocketPort;
+	client->server = server;
+	client->clientId = clientId;
+	client->keepAlive = keepAlive;
+	client->received = received;
+	client->state = MQTT_DISCONNECTED;
+	client->packetId = 0;
+	client->queueLength = 0;
+	client->inflightLength = 0;
+	client->inflightSent = 0;
+	client->subscriptions = 0;
+	client->subscribed = 0;
+}
+
+unsigned char mqttIsConnected(mqttClient *client)
+{
+	return (client->state == MQTT_CONNECTED) ? YES : NO;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+//Packets
+
+unsigned char mqttEncodeLength(unsigned char buffer[], unsigned int length)//remaining length, returns bytes used
+{
+	unsigned char i = 0;
+	
+	do
+	{
+		buffer[i] = length & 0x7F;
+		length >>= 7;
+		if(length)	buffer[i] |= 0x80;
+		i++;
+	}while(length);
+	
+	return i;
+}
+
+//returns 0 if the fixed header is not complete yet
+unsigned int mqttPacketLength(const unsigned char packet[], unsigned int available, unsigned char *headerLength)
+{
+	unsigned long length = 0;
+	unsigned char i;
+	
+	for(i=1; i<5 && i<available; i++)
+	{
+		length |= (unsigned long)(packet[i] & 0x7F) << (7 * (i-1));
+		if(!(packet[i] & 0x80))
+		{
+			*headerLength = i + 1;
+			return (length > 0xFFFF - 5) ? 0xFFFF - 5 : length;//we never take anything that big, it gets skipped
+		}
+	}
+	*headerLength = (i == 5) ? 0xFF : 0;//0xFF - malformed, more than 4 length bytes
+	
+	return 0;
+}
+
+unsigned char mqttPublish(mqttClient *client, const char topic[], const char payload[], unsigned int length, unsigned char qos, unsigned char retain)
+{
+	unsigned int topicLength = strlen(topic);
+	unsigned int remaining = 2 + topicLength + (qos ? 2 : 0) + length;
+	unsigned char lengthBytes[3];
+	unsigned char lengthSize = mqttEncodeLength(lengthBytes, remaining);
+	unsigned int total = 1 + lengthSize + remaining;
+	unsigned char *packet = client->queue + client->queueLength;
+	
+	if(qos > 1)	qos = 1;
+	if(client->queueLength + total > MQTT_QUEUE_SIZE)	return FAIL;
+	if(qos && client->inflightLength + total > MQTT_INFLIGHT_SIZE)	return FAIL;
+	
+	*packet++ = MQTT_PUBLISH | (qos << 1) | (retain ? 1 : 0);
+	memcpy(packet, lengthBytes, lengthSize);
+	packet += lengthSize;
+	*packet++ = topicLength >> 8;
+	*packet++ = topicLength & 0xFF;
+	memcpy(packet, topic, topicLength);
+	packet += topicLength;
+	if(qos)
+	{
+		if(++client->packetId == 0)	client->packetId = 1;//0 is not a valid packet id
+		*packet++ = client->packetId >> 8;
+		*packet++ = client->packetId & 0xFF;
+		memcpy(client->inflight + client->inflightLength, client->queue + client->queueLength, total - length);
+		memcpy(client->inflight + client->inflightLength + total - length, payload, length);
+		client->inflightLength += total;
+	}
+	memcpy(packet, payload, length);
+	client->queueLength += total;
+	
+	return OK;
+}
+
+unsigned char mqttQueueSubscribe(mqttClient *client, const char topic[], unsigned char qos)
+{
+	unsigned int topicLength = strlen(topic);
+	unsigned int remaining = 2 + 2 + topicLength + 1;
+	unsigned char *packet = client->queue + client->queueLength;
+	
+	if(client->queueLength + 3 + remaining > MQTT_QUEUE_SIZE)	return FAIL;
+	
+	if(++client->packetId == 0)	client->packetId = 1;
+	*packet++ = MQTT_SUBSCRIBE;
+	packet += mqttEncodeLength(packet, remaining);
+	*packet++ = client->packetId >> 8;
+	*packet++ = client->packetId & 0xFF;
+	*packet++ = topicLength >> 8;
+	*packet++ = topicLength & 0xFF;
+	memcpy(packet, topic, topicLength);
+	packet += topicLength;
+	*packet++ = qos;
+	client->queueLength = packet - client->queue;
+	
+	return OK;
+}
+
+unsigned char mqttSubscribe(mqttClient *client, const char topic[], unsigned char qos)
+{
+	if(qos > 1)	qos = 1;//QoS 2 is not implemented, the broker downgrades to what we ask for
+	if(client->subscriptions < MQTT_SUBSCRIPTIONS)
+	{
+		client->subscriptionTopic[client->subscriptions] = topic;
+		client->subscriptionQos[client->subscriptions] = qos;
+		client->subscriptions++;
+	}
+	if(client->state != MQTT_CONNECTED)	return OK;//sent after CONNACK
+	if(client->subscribed < client->subscriptions)	client->subscribed++;
+	
+	return mqttQueueSubscribe(client, topic, qos);
+}
+
+unsigned char mqttQueuePacket(mqttClient *client, unsigned char type, unsigned int packetId)//PUBACK, PINGREQ
+{
+	unsigned char *packet = client->queue + client->queueLength;
+	
+	if(client->queueLength + 4 > MQTT_QUEUE_SIZE)	return FAIL;
+	
+	*packet++ = type;
+	if(type == MQTT_PUBACK)
+	{
+		*packet++ = 2;
+		*packet++ = packetId >> 8;
+		*packet++ = packetId & 0xFF;
+	}
+	else
+	{
+		*packet++ = 0;
+	}
+	client->queueLength = packet - client->queue;
+	
+	return OK;
+}
+
+void mqttSendConnect(mqttClient *client)
+{
+	unsigned char packet[14 + MQTT_CLIENT_ID_SIZE];
+	unsigned char idLength = strlen(client->clientId);
+	
+	if(idLength > MQTT_CLIENT_ID_SIZE)	idLength = MQTT_CLIENT_ID_SIZE;
+	
+	packet[0] = MQTT_CONNECT;
+	packet[1] = 12 + idLength;
+	packet[2] = 0;
+	packet[3] = 4;
+	memcpy(packet + 4, "MQTT", 4);
+	packet[8] = 4;//protocol level 3.1.1
+	packet[9] = 0x00;//clean session = 0, the broker keeps subscriptions and QoS 1 messages while we are away
+	packet[10] = client->keepAlive >> 8;
+	packet[11] = client->keepAlive & 0xFF;
+	packet[12] = 0;
+	packet[13] = idLength;
+	memcpy(packet + 14, client->clientId, idLength);
+	
+	ethernetSendData(client->socket, (char *)packet, 14 + idLength);
+	client->lastSent = schedulerTicks();
+}
+
+void mqttResendInflight(mqttClient *client)
+{
+	if(client->inflightSent == 0)	return;
+	
+	ethernetSendData(client->socket, (char *)client->inflight, client->inflightSent);//all of them in one SEND, ones published since the drop are in the queue
+}
+
+//queue belongs to the dead connection, QoS 1 publishes go out again from inflight[] after CONNACK
+void mqttConnectionLost(mqttClient *client)
+{
+	unsigned int offset, length;
+	unsigned char headerLength;
+	
+	for(offset=0; offset<client->inflightSent; offset += headerLength + length)
+	{
+		client->inflight[offset] |= 0x08;//DUP, the broker may have got it already
+		length = mqttPacketLength(client->inflight + offset, client->inflightLength - offset, &headerLength);
+	}
+	client->inflightSent = client->inflightLength;//queued but not sent ones too, the queue is dropped
+	client->queueLength = 0;//PINGREQ, PUBACK, SUBSCRIBE and QoS 0 publishes of the dead session
+	client->pingOutstanding = 0;
+}
+
+void mqttRemoveInflight(mqttClient *client, unsigned int packetId)
+{
+	unsigned int offset, length, topicLength, total;
+	unsigned char headerLength, *packet;
+	
+	for(offset=0; offset<client->inflightLength; offset += total)
+	{
+		packet = client->inflight + offset;
+		length = mqttPacketLength(packet, client->inflightLength - offset, &headerLength);
+		total = headerLength + length;
+		topicLength = ((unsigned int)packet[headerLength] << 8) | packet[headerLength + 1];
+		if((((unsigned int)packet[headerLength + 2 + topicLength] << 8) | packet[headerLength + 3 + topicLength]) == packetId)
+		{
+			memmove(packet, packet + total, client->inflightLength - offset - total);
+			client->inflightLength -= total;
+			client->inflightSent = (client->inflightSent > total) ? client->inflightSent - total : 0;
+			return;
+		}
+	}
+}
+
+//packet = whole packet, length = remaining length
+unsigned char mqttPacket(mqttClient *client, unsigned char packet[], unsigned char headerLength, unsigned int length)
+{
+	unsigned char *data = packet + headerLength;
+	unsigned int topicLength, packetId = 0;
+	unsigned char qos, i;
+	
+	switch(packet[0] & 0xF0)
+	{
+		case MQTT_CONNACK:
+			if(length < 2 || data[1] != 0)	return CONNECTION_CLOSE;//refused
+			client->state = MQTT_CONNECTED;
+			mqttResendInflight(client);
+			if(!(data[0] & 0x01))	client->subscribed = 0;//session present = 0, subscriptions are gone
+			for(i=client->subscribed; i<client->subscriptions; i++)	mqttQueueSubscribe(client, client->subscriptionTopic[i], client->subscriptionQos[i]);
+			client->subscribed = client->subscriptions;
+			break;
+		
+		case MQTT_PUBACK:
+			if(length >= 2)	mqttRemoveInflight(client, ((unsigned int)data[0] << 8) | data[1]);
+			break;
+		
+		case MQTT_PINGRESP:
+			client->pingOutstanding = 0;
+			break;
+		
+		case MQTT_PUBLISH:
+			qos = (packet[0] >> 1) & 0x03;
+			if(length < 2)	return CONNECTION_CLOSE;
+			topicLength = ((unsigned int)data[0] << 8) | data[1];
+			if(2 + topicLength + (qos ? 2 : 0) > length)	return CONNECTION_CLOSE;
+			if(qos)	packetId = ((unsigned int)data[2 + topicLength] << 8) | data[3 + topicLength];
+		
+			if(client->received)
+			{
+				client->received((char *)data + 2, topicLength, (char *)data + 2 + topicLength + (qos ? 2 : 0), length - 2 - topicLength - (qos ? 2 : 0));
+			}
+			if(qos == 1)	mqttQueuePacket(client, MQTT_PUBACK, packetId);
+			break;
+		
+		//SUBACK - nothing to do, failure (0x80) leaves the topic unsubscribed
+	}
+	
+	return CONNECTION_KEEP_ALIVE;
+}
+
+//CONNECTION_PARTIAL if nothing was consumed
+unsigned char mqttReceive(mqttClient *client)
+{
+	unsigned char packet[MQTT_RX_SIZE];
+	unsigned int received, offset, length, topicEnd;
+	unsigned char headerLength, consumed = 0;
+	
+	while((received = ethernetSocketPeekData(client->socket, (char *)packet, MQTT_RX_SIZE)) != 0)
+	{
+		if(client->skip)//rest of a packet that did not fit into packet[]
+		{
+			length = (received < client->skip) ? received : client->skip;
+			ethernetSocketConsume(client->socket, length);
+			client->skip -= length;
+			consumed = 1;
+			continue;
+		}
+		
+		for(offset=0; offset < received; offset += headerLength + length)
+		{
+			length = mqttPacketLength(packet + offset, received - offset, &headerLength);
+			if(headerLength == 0xFF)	return CONNECTION_CLOSE;
+			if(headerLength == 0)	break;//length bytes did not arrive yet
+			if(headerLength + length > MQTT_RX_SIZE)//too big for us, payload dropped
+			{
+				if((packet[offset] & 0xF0) == MQTT_PUBLISH && (packet[offset] & 0x06))//QoS 1 needs PUBACK, the broker redelivers it forever otherwise
+				{
+					if(received - offset < headerLength + 2)	break;//topic length did not arrive yet
+					topicEnd = headerLength + 2 + (((unsigned int)packet[offset + headerLength] << 8) | packet[offset + headerLength + 1]);
+					if(topicEnd + 2 > MQTT_RX_SIZE)	return CONNECTION_CLOSE;//packet id out of our reach, the broker gets it again on the next connection
+					if(received - offset < topicEnd + 2)	break;//packet id is consumed after the previous packets first or did not arrive yet
+					mqttQueuePacket(client, MQTT_PUBACK, ((unsigned int)packet[offset + topicEnd] << 8) | packet[offset + topicEnd + 1]);
+				}
+				client->skip = headerLength + length;
+				break;
+			}
+			if(received - offset < headerLength + length)	break;
+			
+			client->lastReceived = schedulerTicks();
+			if(mqttPacket(client, packet + offset, headerLength, length) == CONNECTION_CLOSE)	return CONNECTION_CLOSE;
+		}
+		
+		if(offset == 0 && client->skip == 0)	break;//nothing complete
+		if(offset)	ethernetSocketConsume(client->socket, offset);
+		consumed = 1;
+	}
+	
+	return consumed ? CONNECTION_KEEP_ALIVE : CONNECTION_PARTIAL;
+}
+
+unsigned char mqttFlush(mqttClient *client)
+{
+	if(client->queueLength == 0)	return FAIL;
+	if(ethernetRXdata16(Sn_TX_FSR_L, client->socket) < client->queueLength)	return FAIL;//try again when the W5500 sent more
+	
+	ethernetSendData(client->socket, (char *)client->queue, client->queueLength);//everything queued in one SEND
+	client->queueLength = 0;
+	client->inflightSent = client->inflightLength;//every QoS 1 publish was queued too
+	client->lastSent = schedulerTicks();
+	
+	return OK;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+//Task
+
+unsigned char mqttClientTask(task *t)
+{
+	mqttClient *client = t->arg;
+	unsigned char busy = 0, result, status;
+	
+	TASK_BEGIN(t);
+	while(1)
+	{
+		client->state = MQTT_DISCONNECTED;
+		ethernetSocketDisconnect(client->socket);
+		ethernetSocketClose(client->socket);
+		if(ethernetSocketOpen(client->socket, client->sourceSocketPort) == FAIL)
+		{
+			TASK_SLEEP(t, MQTT_RECONNECT_DELAY);
+			continue;
+		}
+		
+		ethernetSocketConnect(client->socket, client->server);
+		client->lastReceived = schedulerTicks();
+		TASK_WAIT_UNTIL(t, ((status = ethernetGetStatus(client->socket)) != SOCK_INIT && status != SOCK_SYNSENT) || TICKS_ELAPSED(client->lastReceived) > MQTT_CONNECT_TIMEOUT);//CONNECT may not have left INIT yet
+		if(ethernetIsEstablished(client->socket) == FAIL)
+		{
+			TASK_SLEEP(t, MQTT_RECONNECT_DELAY);
+			continue;
+		}
+		
+		client->state = MQTT_CONNECTING;
+		client->pingOutstanding = 0;
+		client->skip = 0;
+		client->lastReceived = schedulerTicks();
+		mqttSendConnect(client);
+		
+		while(1)
+		{
+			if(ethernetGetStatus(client->socket) != SOCK_ESTABLISHED)	break;//FIN, RST or TCP timeout
+			
+			if(ethernetCheckIfReceivedData(client->socket) == OK)
+			{
+				result = mqttReceive(client);
+				if(result == CONNECTION_CLOSE)	break;
+				if(result == CONNECTION_KEEP_ALIVE)	busy = 1;//start of a packet alone waits without spinning
+			}
+			
+			if(client->state == MQTT_CONNECTING)
+			{
+				if(TICKS_ELAPSED(client->lastReceived) > MQTT_CONNECT_TIMEOUT)	break;//no CONNACK
+			}
+			else
+			{
+				if(client->keepAlive && TICKS_ELAPSED(client->lastSent) >= client->keepAlive * 1000U)
+				{
+					if(client->pingOutstanding)	break;//no PINGRESP within keep alive, broker is gone
+					client->pingOutstanding = mqttQueuePacket(client, MQTT_PINGREQ, 0);
+				}
+				if(mqttFlush(client) == OK)	busy = 1;
+			}
+			
+			if(busy)
+			{
+				TASK_YIELD(t);
+			}
+			else
+			{
+				TASK_POLL(t);
+			}
+		}
+		
+		mqttConnectionLost(client);
+		TASK_SLEEP(t, MQTT_RECONNECT_DELAY);
+	}
+	TASK_END(t);
+}
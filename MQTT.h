@@ -0,0 +1,95 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   MQTT 3.1.1 client for Wiznet W5500 library for AVR XMEGA
+ * @verbatim
+	Persistent session, keep alive, QoS 0/1 publish, subscribe, publishes coalesced into one SEND
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#ifndef MQTT_H_
+#define MQTT_H_
+
+#define MQTT_PORT					1883
+#define MQTT_QUEUE_SIZE				256	//packets waiting for the next SEND
+#define MQTT_INFLIGHT_SIZE			128	//QoS 1 publishes kept until PUBACK, resent with DUP after reconnect
+#define MQTT_RX_SIZE				128	//longest packet received, longer incoming publishes are dropped
+#define MQTT_SUBSCRIPTIONS			4	//topics subscribed again when the broker lost the session
+#define MQTT_CONNECT_TIMEOUT		5000	//ms for TCP connect and CONNACK
+#define MQTT_RECONNECT_DELAY		2000	//ms
+
+//mqttClient.state
+#define MQTT_DISCONNECTED			0
+#define MQTT_CONNECTING				1	//waiting for CONNACK
+#define MQTT_CONNECTED				2
+
+//packet types, upper nibble of the fixed header
+#define MQTT_CONNECT				0x10
+#define MQTT_CONNACK				0x20
+#define MQTT_PUBLISH				0x30
+#define MQTT_PUBACK					0x40
+#define MQTT_SUBSCRIBE				0x82	//with the reserved flags
+#define MQTT_SUBACK					0x90
+#define MQTT_PINGREQ				0xC0
+#define MQTT_PINGRESP				0xD0
+#define MQTT_DISCONNECT				0xE0
+
+
+typedef struct structure11
+{
+	unsigned char socket;
+	unsigned int sourceSocketPort;
+	IPaddressAndPort server;
+	const char *clientId;//RAM, must stay valid
+	unsigned int keepAlive;//seconds, max 65
+	void (*received)(const char topic[], unsigned int topicLength, const char payload[], unsigned int length);
+
+	unsigned char state;
+	unsigned int packetId;
+	unsigned int lastSent;//schedulerTicks()
+	unsigned int lastReceived;
+	unsigned char pingOutstanding;
+	unsigned int skip;//bytes of a dropped packet still to be consumed
+
+	unsigned int queueLength;
+	unsigned char queue[MQTT_QUEUE_SIZE];
+	unsigned int inflightLength;
+	unsigned int inflightSent;//part of inflight[] already sent at least once
+	unsigned char inflight[MQTT_INFLIGHT_SIZE];
+
+	unsigned char subscriptions;
+	unsigned char subscribed;//subscriptions already sent in the current session
+	const char *subscriptionTopic[MQTT_SUBSCRIPTIONS];
+	unsigned char subscriptionQos[MQTT_SUBSCRIPTIONS];
+}mqttClient;
+
+
+//Public prototypes
+
+//mqttInit(&client, SOC6_REG, 50001, broker, "terminal2", 60, handler); schedulerAdd(&mqttTask, mqttClientTask, &client);
+//mqttPublish/mqttSubscribe only queue the packet, everything queued is sent with one SEND in the next task pass
+
+void mqttInit(mqttClient *client, unsigned char socket, unsigned int sourceSocketPort, IPaddressAndPort server, const char clientId[], unsigned int keepAlive, void (*received)(const char topic[], unsigned int topicLength, const char payload[], unsigned int length));
+unsigned char mqttPublish(mqttClient *client, const char topic[], const char payload[], unsigned int length, unsigned char qos, unsigned char retain);//FAIL if the queue is full
+unsigned char mqttSubscribe(mqttClient *client, const char topic[], unsigned char qos);//topic in RAM, must stay valid
+unsigned char mqttIsConnected(mqttClient *client);
+unsigned char mqttClientTask(task *t);//arg = mqttClient, runs forever, reconnects with a persistent session
+
+#endif /* MQTT_H_ */
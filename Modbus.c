@@ -0,0 +1,257 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   Modbus TCP server for Wiznet W5500 library for AVR XMEGA
+ * @verbatim
+	MBAP framing, function codes 1-6, 15, 16 on application register tables, pipelined requests
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#include <stdint.h>
+#include "W5500.h"
+#include "Modbus.h"
+
+
+//Private prototypes
+
+unsigned int modbusWord(const unsigned char data[]);
+unsigned char modbusGetBit(const unsigned char table[], unsigned int bit);
+void modbusSetBit(unsigned char table[], unsigned int bit, unsigned char value);
+unsigned char modbusReadBits(const unsigned char table[], unsigned int size, const unsigned char request[], unsigned char response[], unsigned char *length);
+unsigned char modbusReadRegisters(const unsigned int table[], unsigned int size, const unsigned char request[], unsigned char response[], unsigned char *length);
+unsigned char modbusProcess(const unsigned char pdu[], unsigned char pduLength, unsigned char response[], unsigned char *length);
+unsigned int modbusRequestLength(const unsigned char header[]);
+unsigned int modbusRequest(const unsigned char adu[], unsigned int aduLength, unsigned char response[]);
+unsigned char modbusServerInit(unsigned char socket);
+
+
+unsigned char modbusCoils[(MODBUS_COILS + 7) / 8];
+unsigned char modbusDiscreteInputs[(MODBUS_DISCRETE_INPUTS + 7) / 8];
+unsigned int modbusHoldingRegisters[MODBUS_HOLDING_REGISTERS];
+unsigned int modbusInputRegisters[MODBUS_INPUT_REGISTERS];
+
+static void (*modbusWriteHook)(unsigned char function, unsigned int address, unsigned int quantity);
+
+
+void modbusSetWriteHook(void (*hook)(unsigned char function, unsigned int address, unsigned int quantity))
+{
+	modbusWriteHook = hook;
+}
+
+unsigned int modbusWord(const unsigned char data[])//big endian
+{
+	return ((unsigned int)data[0] << 8) | data[1];
+}
+
+unsigned char modbusGetBit(const unsigned char table[], unsigned int bit)
+{
+	return (table[bit >> 3] >> (bit & 7)) & 1;
+}
+
+void modbusSetBit(unsigned char table[], unsigned int bit, unsigned char value)
+{
+	if(value)	table[bit >> 3] |= (1 << (bit & 7));
+	else		table[bit >> 3] &= ~(1 << (bit & 7));
+}
+
+//request = PDU without function code, response = PDU after function code, *length = response bytes written
+unsigned char modbusReadBits(const unsigned char table[], unsigned int size, const unsigned char request[], unsigned char response[], unsigned char *length)
+{
+	unsigned int address = modbusWord(request);
+	unsigned int quantity = modbusWord(request + 2);
+	unsigned int i;
+	
+	if(quantity < 1 || quantity > 2000)	return MODBUS_ILLEGAL_DATA_VALUE;
+	if((unsigned long)address + quantity > size)	return MODBUS_ILLEGAL_DATA_ADDRESS;
+	
+	response[0] = (quantity + 7) / 8;//byte count
+	for(i=0; i<response[0]; i++)	response[1+i] = 0;
+	for(i=0; i<quantity; i++)
+	{
+		if(modbusGetBit(table, address + i))	response[1 + (i >> 3)] |= (1 << (i & 7));
+	}
+	*length = 1 + response[0];
+	
+	return MODBUS_NO_EXCEPTION;
+}
+
+unsigned char modbusReadRegisters(const unsigned int table[], unsigned int size, const unsigned char request[], unsigned char response[], unsigned char *length)
+{
+	unsigned int address = modbusWord(request);
+	unsigned int quantity = modbusWord(request + 2);
+	unsigned int i;
+	
+	if(quantity < 1 || quantity > 125)	return MODBUS_ILLEGAL_DATA_VALUE;
+	if((unsigned long)address + quantity > size)	return MODBUS_ILLEGAL_DATA_ADDRESS;
+	
+	response[0] = quantity * 2;//byte count
+	for(i=0; i<quantity; i++)
+	{
+		response[1 + i*2] = table[address + i] >> 8;
+		response[2 + i*2] = table[address + i] & 0xFF;
+	}
+	*length = 1 + response[0];
+	
+	return MODBUS_NO_EXCEPTION;
+}
+
+//returns MODBUS_NO_EXCEPTION or exception code, response = PDU after function code
+unsigned char modbusProcess(const unsigned char pdu[], unsigned char pduLength, unsigned char response[], unsigned char *length)
+{
+	unsigned int address, quantity, value, i;
+	
+	if(pduLength < 5)//every supported function has address + quantity/value
+	{
+		if((pdu[0] >= MODBUS_READ_COILS && pdu[0] <= MODBUS_WRITE_SINGLE_REGISTER) || pdu[0] == MODBUS_WRITE_MULTIPLE_COILS || pdu[0] == MODBUS_WRITE_MULTIPLE_REGISTERS)	return MODBUS_ILLEGAL_DATA_VALUE;
+		return MODBUS_ILLEGAL_FUNCTION;
+	}
+	address = modbusWord(pdu + 1);
+	value = quantity = modbusWord(pdu + 3);
+	
+	switch(pdu[0])
+	{
+		case MODBUS_READ_COILS:
+			return modbusReadBits(modbusCoils, MODBUS_COILS, pdu + 1, response, length);
+		
+		case MODBUS_READ_DISCRETE_INPUTS:
+			return modbusReadBits(modbusDiscreteInputs, MODBUS_DISCRETE_INPUTS, pdu + 1, response, length);
+		
+		case MODBUS_READ_HOLDING_REGISTERS:
+			return modbusReadRegisters(modbusHoldingRegisters, MODBUS_HOLDING_REGISTERS, pdu + 1, response, length);
+		
+		case MODBUS_READ_INPUT_REGISTERS:
+			return modbusReadRegisters(modbusInputRegisters, MODBUS_INPUT_REGISTERS, pdu + 1, response, length);
+		
+		case MODBUS_WRITE_SINGLE_COIL:
+			if(value != 0xFF00 && value != 0x0000)	return MODBUS_ILLEGAL_DATA_VALUE;
+			if(address >= MODBUS_COILS)	return MODBUS_ILLEGAL_DATA_ADDRESS;
+			modbusSetBit(modbusCoils, address, value == 0xFF00);
+			quantity = 1;
+			break;
+		
+		case MODBUS_WRITE_SINGLE_REGISTER:
+			if(address >= MODBUS_HOLDING_REGISTERS)	return MODBUS_ILLEGAL_DATA_ADDRESS;
+			modbusHoldingRegisters[address] = value;
+			quantity = 1;
+			break;
+		
+		case MODBUS_WRITE_MULTIPLE_COILS:
+			if(quantity < 1 || quantity > 1968 || pduLength < 6 || pdu[5] != (quantity + 7) / 8 || pduLength != 6 + pdu[5])	return MODBUS_ILLEGAL_DATA_VALUE;
+			if((unsigned long)address + quantity > MODBUS_COILS)	return MODBUS_ILLEGAL_DATA_ADDRESS;
+			for(i=0; i<quantity; i++)
+			{
+				modbusSetBit(modbusCoils, address + i, (pdu[6 + (i >> 3)] >> (i & 7)) & 1);
+			}
+			break;
+		
+		case MODBUS_WRITE_MULTIPLE_REGISTERS:
+			if(quantity < 1 || quantity > 123 || pduLength < 6 || pdu[5] != quantity * 2 || pduLength != 6 + pdu[5])	return MODBUS_ILLEGAL_DATA_VALUE;
+			if((unsigned long)address + quantity > MODBUS_HOLDING_REGISTERS)	return MODBUS_ILLEGAL_DATA_ADDRESS;
+			for(i=0; i<quantity; i++)
+			{
+				modbusHoldingRegisters[address + i] = modbusWord(pdu + 6 + i*2);
+			}
+			break;
+		
+		default:
+			return MODBUS_ILLEGAL_FUNCTION;
+	}
+	
+	//writes answer with address and value/quantity from the request
+	for(i=0; i<4; i++)	response[i] = pdu[1+i];
+	*length = 4;
+	if(modbusWriteHook)	modbusWriteHook(pdu[0], address, quantity);
+	
+	return MODBUS_NO_EXCEPTION;
+}
+
+unsigned int modbusRequestLength(const unsigned char header[])//MBAP length counts unit id + PDU
+{
+	unsigned int length = 6 + modbusWord(header + 4);
+	
+	if(length < 8 || length > MODBUS_ADU_SIZE)	return 0;//lost framing
+	
+	return length;
+}
+
+unsigned int modbusRequest(const unsigned char adu[], unsigned int aduLength, unsigned char response[])
+{
+	unsigned char pduLength, result, i;
+	
+	if(modbusWord(adu + 2) != 0)	return 0;//protocol id must be 0 for Modbus, ignore
+	
+	for(i=0; i<7; i++)	response[i] = adu[i];//transaction id, protocol id, (length), unit id
+	result = modbusProcess(adu + 7, aduLength - 7, response + 8, &pduLength);
+	if(result == MODBUS_NO_EXCEPTION)
+	{
+		response[7] = adu[7];
+		pduLength += 1;//function code
+	}
+	else
+	{
+		response[7] = adu[7] | 0x80;//exception response
+		response[8] = result;
+		pduLength = 2;
+	}
+	response[4] = 0;
+	response[5] = pduLength + 1;//+ unit id
+	
+	return 7 + pduLength;
+}
+
+unsigned char modbusReceive(unsigned char socket)
+{
+	return ethernetSocketReceivePipelined(socket, 8, MODBUS_ADU_SIZE, modbusRequestLength, modbusRequest);//MBAP header + function code
+}
+
+unsigned char modbusServerInit(unsigned char socket)
+{
+	if(ethernetSocketOpen(socket, MODBUS_PORT) == FAIL)	return FAIL;
+	ethernetTXdata8(Sn_KPALVTR, socket, MODBUS_KEEP_ALIVE);//W5500 takes it over at LISTEN only
+	
+	return ethernetSocketListen(socket);
+}
+
+void modbusServer(unsigned char socket)
+{
+	if(ethernetIsEstablished(socket) == OK)
+	{
+		if(ethernetCheckIfReceivedData(socket) == OK)
+		{
+			if(modbusReceive(socket) == CONNECTION_CLOSE)
+			{
+				ethernetSocketDisconnect(socket);
+			}
+		}
+	}
+	
+	if(ethernetCheckIfFINreceived(socket) == OK)
+	{
+		ethernetSocketDisconnect(socket);
+	}
+	
+	if(ethernetCheckIfCloseOrTimeout(socket) == OK)//W5500 keep alive timer closes connections of dead masters
+	{
+		ethernetSocketDisconnect(socket);
+		ethernetSocketClose(socket);//close this socket
+		
+		modbusServerInit(socket);//open and listen to this socket on this port
+	}
+}
@@ -0,0 +1,69 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   Modbus TCP server for Wiznet W5500 library for AVR XMEGA
+ * @verbatim
+	MBAP framing, function codes 1-6, 15, 16 on application register tables, pipelined requests
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#ifndef MODBUS_H_
+#define MODBUS_H_
+
+#define MODBUS_PORT					502
+#define MODBUS_KEEP_ALIVE			6	//Sn_KPALVTR, 6 x 5 s - dead masters are dropped by the W5500, no MCU timeout needed
+
+//Application tables, addresses 0 .. size-1
+#define MODBUS_COILS				64
+#define MODBUS_DISCRETE_INPUTS		64
+#define MODBUS_HOLDING_REGISTERS	64
+#define MODBUS_INPUT_REGISTERS		64
+
+#define MODBUS_ADU_SIZE				260	//MBAP header 7 + PDU 253, pipelined requests share PIPELINE_BUFFER_SIZE
+
+#define MODBUS_READ_COILS					0x01
+#define MODBUS_READ_DISCRETE_INPUTS			0x02
+#define MODBUS_READ_HOLDING_REGISTERS		0x03
+#define MODBUS_READ_INPUT_REGISTERS			0x04
+#define MODBUS_WRITE_SINGLE_COIL			0x05
+#define MODBUS_WRITE_SINGLE_REGISTER		0x06
+#define MODBUS_WRITE_MULTIPLE_COILS			0x0F
+#define MODBUS_WRITE_MULTIPLE_REGISTERS		0x10
+
+#define MODBUS_NO_EXCEPTION					0x00
+#define MODBUS_ILLEGAL_FUNCTION				0x01
+#define MODBUS_ILLEGAL_DATA_ADDRESS			0x02
+#define MODBUS_ILLEGAL_DATA_VALUE			0x03
+
+
+extern unsigned char modbusCoils[(MODBUS_COILS + 7) / 8];//bit n of byte n/8 = coil n
+extern unsigned char modbusDiscreteInputs[(MODBUS_DISCRETE_INPUTS + 7) / 8];
+extern unsigned int modbusHoldingRegisters[MODBUS_HOLDING_REGISTERS];
+extern unsigned int modbusInputRegisters[MODBUS_INPUT_REGISTERS];
+
+
+//Public prototypes
+
+//Call for every socket that should serve a master, e.g. modbusServer(SOC4_REG); modbusServer(SOC5_REG);
+void modbusServer(unsigned char socket);
+unsigned char modbusReceive(unsigned char socket);//all complete requests waiting in RX, CONNECTION_CLOSE on broken framing, CONNECTION_PARTIAL if none was complete
+void modbusSetWriteHook(void (*hook)(unsigned char function, unsigned int address, unsigned int quantity));//called after a master wrote coils/registers
+
+#endif /* MODBUS_H_ */
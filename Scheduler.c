@@ -0,0 +1,156 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   Cooperative task scheduler for AVR XMEGA
+ * @verbatim
+	Cooperative scheduler - stackless tasks (protothreads), 1 ms timer wakeups, idle hook
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "W5500.h"
+#include "Scheduler.h"
+
+
+//Private prototypes
+
+void schedulerTimerInit(void);
+
+
+static task *tasks[SCHEDULER_MAX_TASKS];
+static void (*idleHook)(void);
+static volatile unsigned int tickCount;
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+//change this part if using on other platforms
+
+void schedulerTimerInit(void)
+{
+	TCD0_PER = (F_CPU / 64 / SCHEDULER_TICK_HZ) - 1;//500 counts at CLK/64 = 1 ms
+	TCD0_CTRLA = TC_CLKSEL_DIV64_gc;
+	TCD0_INTCTRLA = TC_OVFINTLVL_LO_gc;
+	PMIC_CTRL |= PMIC_LOLVLEN_bm;
+	sei();
+}
+
+ISR(TCD0_OVF_vect)
+{
+	tickCount++;
+}
+
+unsigned int schedulerTicks(void)
+{
+	unsigned int ticks;
+	unsigned char sreg = SREG;
+
+	cli();//16 bit read is not atomic
+	ticks = tickCount;
+	SREG = sreg;
+
+	return ticks;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+
+void schedulerInit(void)
+{
+	unsigned char i;
+
+	for(i=0; i<SCHEDULER_MAX_TASKS; i++)	tasks[i] = 0;
+	idleHook = 0;
+	schedulerTimerInit();
+}
+
+unsigned char schedulerAdd(task *t, unsigned char (*function)(task *t), void *arg)
+{
+	unsigned char i;
+
+	for(i=0; i<SCHEDULER_MAX_TASKS; i++)
+	{
+		if(tasks[i] == 0)
+		{
+			t->lc = 0;
+			t->sleeping = 0;
+			t->function = function;
+			t->arg = arg;
+			tasks[i] = t;
+			return OK;
+		}
+	}
+	return FAIL;
+}
+
+void schedulerRemove(task *t)
+{
+	unsigned char i;
+
+	for(i=0; i<SCHEDULER_MAX_TASKS; i++)
+	{
+		if(tasks[i] == t)	tasks[i] = 0;
+	}
+}
+
+void schedulerSetIdleHook(void (*hook)(void))
+{
+	idleHook = hook;
+}
+
+void schedulerRunOnce(void)
+{
+	unsigned char i, result, busy = 0;
+	unsigned int now = schedulerTicks();
+	task *t;
+
+	for(i=0; i<SCHEDULER_MAX_TASKS; i++)
+	{
+		t = tasks[i];
+		if(t == 0)	continue;
+
+		if(t->sleeping)
+		{
+			if((int16_t)(now - t->wakeTick) < 0)	continue;//not yet
+			t->sleeping = 0;
+		}
+
+		result = t->function(t);
+		if(result == TASK_EXITED || result == TASK_ENDED)
+		{
+			tasks[i] = 0;
+		}
+		if(result != TASK_WAITING)	busy = 1;
+	}
+
+	if(!busy && idleHook)	idleHook();//e.g. sleep until the next tick
+}
+
+void schedulerRun(void)
+{
+	while(1)
+	{
+		schedulerRunOnce();
+	}
+}
@@ -0,0 +1,73 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   Cooperative task scheduler for AVR XMEGA
+ * @verbatim
+	Cooperative scheduler - stackless tasks (protothreads), 1 ms timer wakeups, idle hook
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#define SCHEDULER_MAX_TASKS		8
+#define SCHEDULER_TICK_HZ		1000UL	//schedulerTicks() resolution, 1 tick = 1 ms
+
+#define TASK_WAITING	0	//condition not met, no work done
+#define TASK_YIELDED	1
+#define TASK_EXITED		2
+#define TASK_ENDED		3
+
+
+typedef struct structure6
+{
+	unsigned int lc;//local continuation, line where the task resumes
+	unsigned int wakeTick;
+	unsigned char sleeping;
+	unsigned char (*function)(struct structure6 *task);
+	void *arg;
+}task;
+
+
+//Task body, local variables are NOT preserved across TASK_YIELD/TASK_WAIT_UNTIL/TASK_SLEEP - keep state in task->arg
+//switch() based, so do not use switch statements that span a yield point
+
+#define TASK_BEGIN(t)				switch((t)->lc) { case 0:
+#define TASK_YIELD(t)				do{ (t)->lc = __LINE__; return TASK_YIELDED; case __LINE__:; }while(0)
+#define TASK_POLL(t)				do{ (t)->lc = __LINE__; return TASK_WAITING; case __LINE__:; }while(0)//yield, no work was done
+#define TASK_WAIT_UNTIL(t, cond)	do{ (t)->lc = __LINE__; case __LINE__: if(!(cond)) return TASK_WAITING; }while(0)
+#define TASK_SLEEP(t, ms)			do{ (t)->wakeTick = schedulerTicks() + (ms); (t)->sleeping = 1; TASK_YIELD(t); }while(0)
+#define TASK_EXIT(t)				do{ (t)->lc = 0; return TASK_EXITED; }while(0)
+#define TASK_END(t)					} (t)->lc = 0; return TASK_ENDED;
+
+#define TICKS_ELAPSED(since)		((unsigned int)(uint16_t)(schedulerTicks() - (since)))
+
+
+//Public prototypes
+
+void schedulerInit(void);//starts the tick timer and enables interrupts
+unsigned char schedulerAdd(task *t, unsigned char (*function)(task *t), void *arg);//FAIL if no free slot
+void schedulerRemove(task *t);
+void schedulerSetIdleHook(void (*hook)(void));//called when no task did any work in a round
+void schedulerRunOnce(void);//one round over all tasks
+void schedulerRun(void);//never returns
+unsigned int schedulerTicks(void);
+
+#endif /* SCHEDULER_H_ */
@@ -30,9 +30,14 @@
 #include <avr/io.h>
 #include <avr/pgmspace.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include "UART-XMEGA.h"
 #include "W5500.h"
+#include "HTTP.h"
+#include "WebSocket.h"
+#include "DNS.h"
+#include "Frame.h"
 
 
 //Private prototypes
@@ -41,37 +46,61 @@ void ethernetSPIinit(void);
 void ethernetSPItx8(unsigned char data);
 unsigned char ethernetSPIrx8();
 void ethernetSPItx16(unsigned int data);
-void ethernetTXdata8(unsigned int address, unsigned char block, unsigned char data);
-unsigned char ethernetRXdata8(unsigned int address, unsigned char block);
-unsigned int ethernetRXdata16(unsigned char lsbAddr, unsigned char socket);
-void ethernetTXdata16(unsigned char lsbAddr, unsigned char socket, unsigned int data);
 void ethernetWrite4Bytes(unsigned char byte0, unsigned char byte1, unsigned char byte2, unsigned char byte3, unsigned int reg);
 void ethernetWrite6Bytes(unsigned char byte0, unsigned char byte1, unsigned char byte2, unsigned char byte3, unsigned char byte4, unsigned char byte5, unsigned int reg);
-//////////////////////////////////////////////////////////////////////////
-unsigned char ethernetGetStatus(unsigned char socket);
-void ethernetSetStatus(unsigned char socket, unsigned char data);
-unsigned char ethernetIsEstablished(unsigned char socket);
-unsigned char ethernetCheckIfReceivedData(unsigned char socket);
-unsigned int ethernetSocketReceiveData(unsigned char socket, char data[]);
-void ethernetSendData(unsigned char socket, char data[], unsigned int length);
-void ethernetSendText(unsigned char socket, const char data[]);
-void ethernetSendTextf(unsigned char socket, char *data, ...);
-unsigned char ethernetCheckIfFINreceived(unsigned char socket);
-unsigned char ethernetCheckIfCloseOrTimeout(unsigned char socket);
-void ethernetSocketDisconnect(unsigned char socket);
-void ethernetSocketClose(unsigned char socket);
-unsigned char ethernetSocketOpen(unsigned char socket, unsigned int socketPort);
-unsigned char ethernetSocketListen(unsigned char socket);
-void ethernetPrintSocketStatus(unsigned char socket);
-void ethernetSocketConnect(unsigned char socket, IPaddressAndPort server);//Write IP address and server port
+void ethernetSocketDestination(unsigned char socket, IPaddressAndPort server);
 
 
 //TCP server and client
-unsigned char TCPserverInit(unsigned char socket, unsigned int socketPort);
 unsigned char serverProcessReceivedData(unsigned char socket, char data[], unsigned int length);
 void sendHTMLHeader(unsigned char socket);
+void serverProcessWebsocketData(unsigned char socket, char data[], unsigned int length);
 unsigned char clientSendCommand(unsigned char socket, unsigned long command);
 unsigned char clientProcessReceivedData(unsigned char socket, char data[], unsigned int length, unsigned long *command);
+unsigned char clientProcessHTTPResponse(httpResponse *response, unsigned long *command);
+unsigned char clientReceiveHTTPResponse(unsigned char socket, httpResponse *response, unsigned long *command);
+void clientClosedHTTPResponse(unsigned char socket, httpResponse *response, unsigned long *command);
+
+//PHY link monitor
+static unsigned char ethernetLinkPHY;//PHYCFGR at the last ethernetLinkMonitor() call
+static unsigned char ethernetLinkSeeded;//first call only takes the link state, a link that is up is no recovery
+static void (*ethernetLinkHook)(unsigned char event, unsigned char phy);
+
+//HTTP client, next command on a kept-alive connection
+static unsigned char (*clientResponseHook)(unsigned long *command, const httpResponse *response);
+
+//ethernetSocketReceivePipelined, never yields - one buffer pair serves every socket and protocol
+static unsigned char pipelineRX[PIPELINE_BUFFER_SIZE];
+static unsigned char pipelineTX[PIPELINE_BUFFER_SIZE];
+
+//Performance counters
+#if ETHERNET_STATS
+ethernetStatistics ethernetStats[8];
+ethernetStatistics ethernetStatsTotal;
+static unsigned char ethernetStatsEstablished;//one bit per socket, connection already counted
+
+static void ethernetStatsSPI(unsigned char block, unsigned int bytes);
+static void ethernetStatsConnected(unsigned char socket);
+static void ethernetStatsLoop(unsigned char socket, unsigned int start);
+void sendStatsJSONobject(ethernetStatistics *stats, char *end);
+void sendStatsJSON(unsigned char socket);
+
+#define STATS_ADD(socket, field, value)	do{ethernetStats[(socket) >> 2].field += (value); ethernetStatsTotal.field += (value);}while(0)
+#define STATS_SPI(block, bytes)			ethernetStatsSPI(block, bytes)
+#define STATS_SPI_BYTES(block, bytes)	do{ethernetStats[(block) >> 2].spiBytes += (bytes); ethernetStatsTotal.spiBytes += (bytes);}while(0)
+#define STATS_CONNECTED(socket)			ethernetStatsConnected(socket)
+#define STATS_DISCONNECTED(socket)		(ethernetStatsEstablished &= ~(1 << ((socket) >> 2)))
+#define STATS_LOOP_START(start)			unsigned int start = ETHERNET_STATS_TIMER()
+#define STATS_LOOP_END(socket, start)	ethernetStatsLoop(socket, start)
+#else
+#define STATS_ADD(socket, field, value)	do{}while(0)
+#define STATS_SPI(block, bytes)			do{}while(0)
+#define STATS_SPI_BYTES(block, bytes)	do{}while(0)
+#define STATS_CONNECTED(socket)			do{}while(0)
+#define STATS_DISCONNECTED(socket)		do{}while(0)
+#define STATS_LOOP_START(start)
+#define STATS_LOOP_END(socket, start)	do{}while(0)
+#endif
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -81,6 +110,10 @@ unsigned char clientProcessReceivedData(unsigned char socket, char data[], unsig
 #define CS_ENABLE() (PORTE_OUTCLR = 0b00010000);_delay_us(1);
 #define CS_DISABLE() (PORTE_OUTSET = 0b00010000)
 
+//RSTn of the W5500, empty if the pin is not connected - ethernetHardwareReset() then resets by MR only
+#define RESET_ENABLE()		//e.g. {PORTE_DIRSET = 0b00001000; PORTE_OUTCLR = 0b00001000;}
+#define RESET_DISABLE()		//e.g. (PORTE_OUTSET = 0b00001000)
+
 void ethernetSPIinit(void)
 {
 	PORTE_DIRSET = 0b10110000;
@@ -127,6 +160,7 @@ void ethernetTXdata8(unsigned int address, unsigned char block, unsigned char da
 	ethernetSPItx8((block << 3) + 0b00000101);//enable write //one byte size
 	ethernetSPItx8(data);
 	CS_DISABLE();
+	STATS_SPI(block, 4);
 }
 
 unsigned char ethernetRXdata8(unsigned int address, unsigned char block)
@@ -138,6 +172,7 @@ unsigned char ethernetRXdata8(unsigned int address, unsigned char block)
 	ethernetSPItx8((block << 3) + 0b00000001);//enable read //one byte size
 	RXdata = ethernetSPIrx8();
 	CS_DISABLE();
+	STATS_SPI(block, 4);
 	return RXdata;//returning received data
 }
 
@@ -221,6 +256,9 @@ unsigned int ethernetSocketReceiveData(unsigned char socket, char data[])
 	
 	CS_DISABLE();
 	data[i] = '\0';
+	STATS_SPI(socket + 2, 3 + length);
+	STATS_ADD(socket, bytesRX, length);
+	if(length >= RX_BUFFER_SIZE)	STATS_ADD(socket, bufferFull, 1);
 	
 	ethernetTXdata16(Sn_RX_RD_L, socket, readPtr+length);
 	ethernetSetStatus(socket, Sn_RECV);
@@ -229,6 +267,105 @@ unsigned int ethernetSocketReceiveData(unsigned char socket, char data[])
 	return (length);// >0 if some data was received
 }
 
+unsigned int ethernetSocketReceiveStream(unsigned char socket, unsigned char (*consume)(void *context, char data), void *context)
+{
+	unsigned int length, i;
+	unsigned int readPtr = ethernetRXdata16(Sn_RX_RD_L, socket);//get read address
+	
+	do //same as ethernetSocketReceiveData
+	{
+		length = ethernetRXdata16(Sn_RX_RSR_L, socket);
+	}while(length != ethernetRXdata16(Sn_RX_RSR_L, socket));
+	if(length == 0)	return 0;
+	
+	CS_ENABLE();
+	ethernetSPItx16(readPtr);
+	ethernetSPItx8(((socket + 2) << 3) + 0b00000000);// +2 to get RXBUF //enable read //variable data size
+	
+	for(i=0; i<length; )
+	{
+		i++;
+		if(consume(context, ethernetSPIrx8()) == FAIL)	break;//consumer is done, the rest stays in the RX buffer
+	}
+	
+	CS_DISABLE();
+	STATS_SPI(socket + 2, 3 + i);
+	STATS_ADD(socket, bytesRX, i);
+	
+	ethernetTXdata16(Sn_RX_RD_L, socket, readPtr+i);
+	ethernetSetStatus(socket, Sn_RECV);
+	
+	return i;//bytes consumed
+}
+
+unsigned int ethernetSocketPeekData(unsigned char socket, char data[], unsigned int size)
+{
+	unsigned int length, i;
+	unsigned int readPtr = ethernetRXdata16(Sn_RX_RD_L, socket);//get read address
+	
+	do //same as ethernetSocketReceiveData
+	{
+		length = ethernetRXdata16(Sn_RX_RSR_L, socket);
+	}while(length != ethernetRXdata16(Sn_RX_RSR_L, socket));
+	if(length > size)	length = size;
+	if(length == 0)	return 0;
+	
+	CS_ENABLE();
+	ethernetSPItx16(readPtr);
+	ethernetSPItx8(((socket + 2) << 3) + 0b00000000);// +2 to get RXBUF //enable read //variable data size
+	for(i=0; i<length; i++)
+	{
+		data[i] = ethernetSPIrx8();
+	}
+	CS_DISABLE();
+	STATS_SPI(socket + 2, 3 + length);
+	
+	return length;
+}
+
+void ethernetSocketConsume(unsigned char socket, unsigned int length)
+{
+	STATS_ADD(socket, bytesRX, length);
+	ethernetTXdata16(Sn_RX_RD_L, socket, ethernetRXdata16(Sn_RX_RD_L, socket) + length);
+	ethernetSetStatus(socket, Sn_RECV);
+}
+
+unsigned char ethernetSocketReceivePipelined(unsigned char socket, unsigned int headerSize, unsigned int maxResponse, unsigned int (*requestLength)(const unsigned char header[]), unsigned int (*process)(const unsigned char request[], unsigned int length, unsigned char response[]))
+{
+	unsigned int received, offset, length, responseLength = 0;
+	unsigned char result = CONNECTION_PARTIAL;
+	
+	//pipelined requests are peeked together, an incomplete one stays in the RX buffer for the next call
+	while((received = ethernetSocketPeekData(socket, (char *)pipelineRX, PIPELINE_BUFFER_SIZE)) >= headerSize)
+	{
+		for(offset=0; received - offset >= headerSize; offset += length)
+		{
+			length = requestLength(pipelineRX + offset);
+			if(length < headerSize || length > PIPELINE_BUFFER_SIZE)//lost framing, no way to resynchronize
+			{
+				if(responseLength)	ethernetSendData(socket, (char *)pipelineTX, responseLength);//requests before it are executed and consumed, their answers go out
+				return CONNECTION_CLOSE;
+			}
+			if(received - offset < length)	break;//rest of the request did not arrive yet
+			
+			if(responseLength + maxResponse > PIPELINE_BUFFER_SIZE)//no room for the longest response, send what we have
+			{
+				ethernetSendData(socket, (char *)pipelineTX, responseLength);
+				responseLength = 0;
+			}
+			responseLength += process(pipelineRX + offset, length, pipelineTX + responseLength);
+		}
+		
+		if(offset == 0)	break;
+		ethernetSocketConsume(socket, offset);
+		result = CONNECTION_KEEP_ALIVE;
+	}
+	
+	if(responseLength)	ethernetSendData(socket, (char *)pipelineTX, responseLength);
+	
+	return result;
+}
+
 void ethernetSendData(unsigned char socket, char data[], unsigned int length)
 {
 	unsigned int i;
@@ -248,6 +385,9 @@ void ethernetSendData(unsigned char socket, char data[], unsigned int length)
 		ethernetSPItx8(data[i]);
 	}
 	CS_DISABLE();
+	STATS_SPI(socket + 1, 3 + i);
+	STATS_ADD(socket, bytesTX, i);
+	STATS_ADD(socket, sendCommands, 1);
 	
 	ethernetTXdata16(Sn_TX_WR_L, socket, writePtr + i);
 	ethernetSetStatus(socket, Sn_SEND);
@@ -268,6 +408,9 @@ void ethernetSendText(unsigned char socket, const char data[])
 		i++;
 	}
 	CS_DISABLE();
+	STATS_SPI(socket + 1, 3 + i);
+	STATS_ADD(socket, bytesTX, i);
+	STATS_ADD(socket, sendCommands, 1);
 	
 	ethernetTXdata16(Sn_TX_WR_L, socket, writePtr + i);
 	ethernetSetStatus(socket, Sn_SEND);
@@ -293,11 +436,129 @@ void ethernetSendTextf(unsigned char socket, char *data, ...)
 		ethernetSPItx8(buffer[i++]);
 	}
 	CS_DISABLE();
+	STATS_SPI(socket + 1, 3 + i);
+	STATS_ADD(socket, bytesTX, i);
+	STATS_ADD(socket, sendCommands, 1);
 	
 	ethernetTXdata16(Sn_TX_WR_L, socket, writePtr + i);
 	ethernetSetStatus(socket, Sn_SEND);
 }
 
+//Streaming writes into the TX buffer, one SEND for everything written between Begin and End
+//Only one stream can be open at a time, nothing else may use the SPI while the stream frame is open
+
+static unsigned char streamSocket;
+static unsigned int streamStart;//TX write pointer at ethernetStreamBegin
+static unsigned int streamLength;
+static unsigned int streamLimit;//TX free size at ethernetStreamBegin
+static unsigned char streamFrameOpen;
+static unsigned char streamOverflow;
+
+static void ethernetStreamFrameClose(void)
+{
+	if(!streamFrameOpen)	return;
+	CS_DISABLE();
+	streamFrameOpen = 0;
+}
+
+unsigned char ethernetStreamBegin(unsigned char socket)
+{
+	streamSocket = socket;
+	streamStart = ethernetRXdata16(Sn_TX_WR_L, socket);//get the TX Write Pointer
+	streamLimit = ethernetRXdata16(Sn_TX_FSR_L, socket);//never overwrite data not yet sent
+	streamLength = 0;
+	streamFrameOpen = 0;
+	streamOverflow = 0;
+	
+	return (streamLimit != 0) ? OK : FAIL;
+}
+
+void ethernetStreamByte(char data)
+{
+	if(streamLength >= streamLimit)
+	{
+		streamOverflow = 1;
+		return;
+	}
+	
+	if(!streamFrameOpen)//frame is reopened after ethernetStreamPatch
+	{
+		CS_ENABLE();
+		ethernetSPItx16(streamStart + streamLength);
+		ethernetSPItx8(((streamSocket + 1) << 3) + 0b00000100);//+1 to get TXBUF //enable write //variable data size
+		STATS_SPI(streamSocket + 1, 3);
+		streamFrameOpen = 1;
+	}
+	
+	ethernetSPItx8(data);
+	streamLength++;
+	STATS_SPI_BYTES(streamSocket + 1, 1);
+}
+
+void ethernetStreamText(const char data[])
+{
+	while(pgm_read_byte(data))
+	{
+		ethernetStreamByte(pgm_read_byte(data++));
+	}
+}
+
+void ethernetStreamString(const char data[])
+{
+	while(*data)
+	{
+		ethernetStreamByte(*data++);
+	}
+}
+
+void ethernetStreamf(const char format[], ...)
+{
+	char buffer[128];//how long string it can process
+	
+	va_list pArgs;
+	va_start(pArgs, format);
+	vsnprintf(buffer, (sizeof(buffer)/sizeof(buffer[0])) - 1, format, pArgs);
+	va_end(pArgs);
+	
+	ethernetStreamString(buffer);
+}
+
+unsigned int ethernetStreamPosition(void)
+{
+	return streamLength;
+}
+
+void ethernetStreamPatch(unsigned int position, const char data[], unsigned int length)
+{
+	unsigned int i;
+	
+	if(position + length > streamLength)	return;//only bytes already written can be patched
+	
+	ethernetStreamFrameClose();
+	CS_ENABLE();
+	ethernetSPItx16(streamStart + position);
+	ethernetSPItx8(((streamSocket + 1) << 3) + 0b00000100);//+1 to get TXBUF //enable write //variable data size
+	for(i=0; i<length; i++)
+	{
+		ethernetSPItx8(data[i]);
+	}
+	CS_DISABLE();
+	STATS_SPI(streamSocket + 1, 3 + length);
+}
+
+unsigned char ethernetStreamEnd(void)
+{
+	ethernetStreamFrameClose();
+	if(streamOverflow)	return FAIL;//TX write pointer is not moved, nothing is sent
+	
+	STATS_ADD(streamSocket, bytesTX, streamLength);
+	STATS_ADD(streamSocket, sendCommands, 1);
+	ethernetTXdata16(Sn_TX_WR_L, streamSocket, streamStart + streamLength);
+	ethernetSetStatus(streamSocket, Sn_SEND);
+	
+	return OK;
+}
+
 unsigned char ethernetCheckIfFINreceived(unsigned char socket)
 {
 	if(ethernetGetStatus(socket) == SOCK_CLOSE_WAIT)
@@ -341,6 +602,95 @@ unsigned char ethernetSocketOpen(unsigned char socket, unsigned int socketPort)
 	}
 }
 
+unsigned char ethernetSocketOpenUDP(unsigned char socket, unsigned int socketPort)
+{
+	ethernetTXdata8(Sn_MR, socket, Sn_MR_UDP);//set to UDP mode
+	ethernetTXdata16(Sn_PORT1, socket, socketPort);
+	ethernetTXdata8(Sn_CR, socket, Sn_CR_OPEN);//open
+	
+	if(ethernetGetStatus(socket) != SOCK_UDP)
+	{
+		ethernetSocketClose(socket);
+		return FAIL;
+	}
+	else
+	{
+		return OK;
+	}
+}
+
+void ethernetSendDataTo(unsigned char socket, IPaddressAndPort destination, char data[], unsigned int length)
+{
+	ethernetSocketDestination(socket, destination);
+	ethernetSendData(socket, data, length);//W5500 sends the TX buffer as one datagram
+}
+
+unsigned int ethernetSocketReceiveBuffer(unsigned char socket, char data[], unsigned int size)
+{
+	unsigned int length, received, i;
+	unsigned int readPtr = ethernetRXdata16(Sn_RX_RD_L, socket);//get read address
+	
+	do //same as ethernetSocketReceiveData
+	{
+		received = ethernetRXdata16(Sn_RX_RSR_L, socket);
+	}while(received != ethernetRXdata16(Sn_RX_RSR_L, socket));
+	length = (received < size) ? received : size - 1;//room for '\0', rest stays in the RX buffer
+	
+	CS_ENABLE();
+	ethernetSPItx16(readPtr);
+	ethernetSPItx8(((socket + 2) << 3) + 0b00000000);// +2 to get RXBUF //enable read //variable data size
+	for(i=0; i<length; i++)
+	{
+		data[i] = ethernetSPIrx8();
+	}
+	CS_DISABLE();
+	data[i] = '\0';
+	STATS_SPI(socket + 2, 3 + length);
+	STATS_ADD(socket, bytesRX, length);
+	if(length < received)	STATS_ADD(socket, bufferFull, 1);
+	
+	ethernetTXdata16(Sn_RX_RD_L, socket, readPtr+length);
+	ethernetSetStatus(socket, Sn_RECV);
+	
+	return length;
+}
+
+unsigned int ethernetSocketReceiveDatagram(unsigned char socket, IPaddressAndPort *source, char data[], unsigned int size)
+{
+	unsigned char header[8];//source IP, source port, datagram length
+	unsigned int length, i;
+	unsigned int readPtr = ethernetRXdata16(Sn_RX_RD_L, socket);//get read address
+	
+	if(ethernetRXdata16(Sn_RX_RSR_L, socket) < 8)	return 0;//W5500 stores whole datagrams, so the header means the data is there too
+	
+	CS_ENABLE();
+	ethernetSPItx16(readPtr);
+	ethernetSPItx8(((socket + 2) << 3) + 0b00000000);// +2 to get RXBUF //enable read //variable data size
+	for(i=0; i<8; i++)
+	{
+		header[i] = ethernetSPIrx8();
+	}
+	length = ((unsigned int)header[6] << 8) | header[7];
+	for(i=0; i<length && i<size; i++)//header and data in one SPI frame
+	{
+		data[i] = ethernetSPIrx8();
+	}
+	CS_DISABLE();
+	STATS_SPI(socket + 2, 3 + 8 + i);
+	STATS_ADD(socket, bytesRX, length);
+	
+	source->b0 = header[0];
+	source->b1 = header[1];
+	source->b2 = header[2];
+	source->b3 = header[3];
+	source->socketPort = ((unsigned int)header[4] << 8) | header[5];
+	
+	ethernetTXdata16(Sn_RX_RD_L, socket, readPtr + 8 + length);//rest of a longer datagram is dropped
+	ethernetSetStatus(socket, Sn_RECV);
+	
+	return i;//bytes copied
+}
+
 unsigned char ethernetSocketListen(unsigned char socket)
 {
 	ethernetSetStatus(socket, Sn_CR_LISTEN);//listen
@@ -366,6 +716,91 @@ void ethernetInit(address IPaddress, address mask, address gateway, MACaddress M
 	ethernetWrite6Bytes(MACadr.b0, MACadr.b1, MACadr.b2, MACadr.b3, MACadr.b4, MACadr.b5, SHAR);//MAC ADDRESS
 }
 
+unsigned char ethernetHardwareReset(void)//all registers are reset, call ethernetInit() afterwards
+{
+	unsigned char i;
+	
+	ethernetSPIinit();
+	RESET_ENABLE();
+	_delay_us(500);//RSTn low for at least 500 us
+	RESET_DISABLE();
+	
+	ethernetTXdata8(MR, 0, MR_RST);//software reset, the only one when RSTn is not connected
+	for(i=0; i<W5500_RESET_TIMEOUT; i++)//PLL locks within 1 ms after reset
+	{
+		_delay_us(100);
+		if(ethernetRXdata8(VERSIONR, 0) == W5500_VERSION && !(ethernetRXdata8(MR, 0) & MR_RST))	return OK;
+	}
+	
+	return FAIL;//no W5500 or SPI is broken
+}
+
+unsigned char ethernetGetPHYstatus(void)
+{
+	return ethernetRXdata8(PHYCFGR, 0);
+}
+
+void ethernetSetPHYmode(unsigned char mode)
+{
+	ethernetTXdata8(PHYCFGR, 0, PHYCFGR_OPMD | mode);//RST = 0, PHY restarts with the new mode
+	ethernetTXdata8(PHYCFGR, 0, PHYCFGR_RST | PHYCFGR_OPMD | mode);
+}
+
+void ethernetSetLinkHook(void (*hook)(unsigned char event, unsigned char phy))
+{
+	ethernetLinkHook = hook;
+}
+
+unsigned char ethernetLinkMonitor(void)
+{
+	unsigned char phy = ethernetGetPHYstatus();
+	unsigned char event, i, status;
+	
+	if(!ethernetLinkSeeded)
+	{
+		ethernetLinkSeeded = 1;
+		ethernetLinkPHY = phy;
+	}
+	if(!((phy ^ ethernetLinkPHY) & PHYCFGR_LNK))
+	{
+		ethernetLinkPHY = phy;
+		return LINK_UNCHANGED;
+	}
+	ethernetLinkPHY = phy;
+	
+	if(phy & PHYCFGR_LNK)
+	{
+		event = LINK_UP;
+		for(i=0; i<8; i++)//connections from before the outage are most likely dead on the other side
+		{
+			status = ethernetGetStatus((i << 2) + 1);
+			if(status != SOCK_CLOSED && status != SOCK_INIT && status != SOCK_LISTEN && status != SOCK_UDP && status != SOCK_MACRAW)
+			{
+				STATS_DISCONNECTED((i << 2) + 1);
+				ethernetSocketClose((i << 2) + 1);//TCPserver/TCPserverTask listen again in their next pass
+			}
+		}
+	}
+	else
+	{
+		event = LINK_DOWN;
+	}
+	if(ethernetLinkHook)	ethernetLinkHook(event, phy);
+	
+	return event;
+}
+
+unsigned char ethernetLinkTask(task *t)
+{
+	TASK_BEGIN(t);
+	while(1)
+	{
+		ethernetLinkMonitor();
+		TASK_SLEEP(t, LINK_POLL_INTERVAL);
+	}
+	TASK_END(t);
+}
+
 void ethernetPrintSocketStatus(unsigned char socket)
 {
 	switch(ethernetGetStatus(socket))
@@ -389,15 +824,20 @@ void ethernetPrintSocketStatus(unsigned char socket)
 	}
 }
 
-void ethernetSocketConnect(unsigned char socket, IPaddressAndPort server)//Write IP address and server port
+void ethernetSocketDestination(unsigned char socket, IPaddressAndPort server)//Write IP address and server port
 {
-	//ethernetSPIinit();
 	ethernetTXdata8(Sn_DIPR0, socket, server.b0);
 	ethernetTXdata8(Sn_DIPR0+1, socket, server.b1);
 	ethernetTXdata8(Sn_DIPR0+2, socket, server.b2);
 	ethernetTXdata8(Sn_DIPR0+3, socket, server.b3);
 	
 	ethernetTXdata16(Sn_DPORT1, socket, server.socketPort);
+}
+
+void ethernetSocketConnect(unsigned char socket, IPaddressAndPort server)//Write IP address and server port
+{
+	//ethernetSPIinit();
+	ethernetSocketDestination(socket, server);
 	
 	ethernetSetStatus(socket, Sn_CR_CONNECT);
 	
@@ -439,6 +879,18 @@ unsigned char serverProcessReceivedData(unsigned char socket, char data[], unsig
 			ethernetSendText(socket, PSTR("<h4>Help: lukas.herudek@gmail.com / +420 604 837 437</h4>\r\n\r\n"));
 			return CONNECTION_CLOSE;
 		}
+		else if(strstr(data, "/ws "))//push channel, stays open, websocketAccept checks the handshake headers
+		{
+			if(websocketAccept(socket, data, serverProcessWebsocketData) == OK)	return CONNECTION_KEEP_ALIVE;
+			return CONNECTION_CLOSE;
+		}
+#if ETHERNET_STATS
+		else if(strstr(data, "/stats "))//performance counters
+		{
+			sendStatsJSON(socket);
+			return CONNECTION_CLOSE;
+		}
+#endif
 		else
 		{
 			sendHTMLHeader(socket);
@@ -468,27 +920,69 @@ unsigned char serverProcessReceivedData(unsigned char socket, char data[], unsig
 	}
 }
 
+void serverProcessWebsocketData(unsigned char socket, char data[], unsigned int length)
+{
+	if(strstr(data, "HELLO"))
+	{
+		websocketSendText(socket, "HELLO 2 YOU!");
+	}
+	else
+	{
+		websocketSend(socket, WEBSOCKET_TEXT, data, length);//echo
+	}
+}
+
 void TCPserver(unsigned char socket, unsigned int socketPort)
 {
 	char RXbuffer[RX_BUFFER_SIZE];
 	unsigned int i, length;
+	unsigned char upgraded, result;
 	static unsigned int timeoutAlive=0;
+	STATS_LOOP_START(loopStart);
 	
 	if(ethernetIsEstablished(socket) == OK)
 	{
-		timeoutAlive++;
+		STATS_CONNECTED(socket);
+		upgraded = websocketIsOpen(socket);
+		if(upgraded == NO)	timeoutAlive++;//upgraded sockets stay open until closed by the client
 		
-		if(ethernetCheckIfReceivedData(socket) == OK)
+		if(upgraded == YES && ethernetCheckIfReceivedData(socket) == OK)
 		{
-			for(i=0; i<RX_BUFFER_SIZE; i++)		RXbuffer[i] = 0;//clear buffer
-			timeoutAlive = 0;
-			
-			length = ethernetSocketReceiveData(socket, RXbuffer);
-			if(serverProcessReceivedData(socket, RXbuffer, length) == CONNECTION_CLOSE)
+			if(websocketReceive(socket) == CONNECTION_CLOSE)
 			{
 				ethernetSocketDisconnect(socket);
 			}
 		}
+		else if(upgraded == NO && ethernetCheckIfReceivedData(socket) == OK)
+		{
+			if(frameWaiting(socket) == YES)//binary frames are parsed straight from the RX buffer, connection stays open
+			{
+				result = frameReceive(socket);
+				if(result == CONNECTION_CLOSE)
+				{
+					ethernetSocketDisconnect(socket);
+				}
+				else if(result == CONNECTION_KEEP_ALIVE)
+				{
+					timeoutAlive = 0;
+				}
+				else
+				{
+					_delay_ms(1);//start of a frame alone is no activity, it times out like an idle connection
+				}
+			}
+			else
+			{
+				timeoutAlive = 0;
+				for(i=0; i<RX_BUFFER_SIZE; i++)		RXbuffer[i] = 0;//clear buffer
+				
+				length = ethernetSocketReceiveData(socket, RXbuffer);
+				if(serverProcessReceivedData(socket, RXbuffer, length) == CONNECTION_CLOSE)
+				{
+					ethernetSocketDisconnect(socket);
+				}
+			}
+		}
 		else
 		{
 			_delay_ms(1);//for timeout recognition 
@@ -502,17 +996,23 @@ void TCPserver(unsigned char socket, unsigned int socketPort)
 
 	if(ethernetCheckIfCloseOrTimeout(socket) == OK  || (timeoutAlive > WAIT_FOR_DATA_RECEIVE))//try 10000 times to receive data, then close socket
 	{
+		if(timeoutAlive > WAIT_FOR_DATA_RECEIVE)	STATS_ADD(socket, timeouts, 1);
+		STATS_DISCONNECTED(socket);
+		websocketClosed(socket);
 		timeoutAlive = 0;
 		ethernetSocketDisconnect(socket);
 		ethernetSocketClose(socket);//close this socket
 		
 		TCPserverInit(socket, socketPort);//open and listen to this socket on this port
 	}
+	
+	STATS_LOOP_END(socket, loopStart);
 }
 
 unsigned char TCPserverInit(unsigned char socket, unsigned int socketPort)
 {
 	if(ethernetSocketOpen(socket, socketPort) == FAIL)	return FAIL;//check if opening socket was successful
+	ethernetTXdata8(Sn_KPALVTR, socket, WEBSOCKET_KEEP_ALIVE);//W5500 takes it over at LISTEN only, an upgrade later could not set it
 	if(ethernetSocketListen(socket) == FAIL)	return FAIL;//check if listening settings set was successful
 	
 	return OK;
@@ -532,11 +1032,24 @@ unsigned char clientSendCommand(unsigned char socket, unsigned long command)
 		//case 0: ethernetSendText(socket, PSTR("GET /index.html HTTP/1.1\r\nHost: stavebnice.tipa.eu\r\n\r\n")); return CONNECTION_KEEP_ALIVE;
 		
 		
-		case 0: ethernetSendText(socket, PSTR("POST /connect/recive HTTP/1.1\r\nHost: server0.pi-chacka.tipa.eu:28080\r\nContent-Type: application/json\r\nContent-Length: 124\r\n\r\n{\"hostname\":\"terminal2\",\"password\":\"Yn6n9HkjGJ\",\"command\":\"insert_new_atro\",\"user_id\":\"9990\",\"type\":\"work\",\"subtype\":\"stop\"}")); return CONNECTION_KEEP_ALIVE;
-		
+		case 0:
+			if(httpPostBegin(socket, PSTR(CLIENT_PATH), PSTR(CLIENT_HOST)) == FAIL)	break;//TX buffer full
+			jsonString(PSTR("hostname"), PSTR(CLIENT_HOSTNAME));
+			jsonString(PSTR("password"), PSTR(CLIENT_PASSWORD));
+			jsonString(PSTR("command"), PSTR("insert_new_atro"));
+			jsonString(PSTR("user_id"), PSTR("9990"));
+			jsonString(PSTR("type"), PSTR("work"));
+			jsonString(PSTR("subtype"), PSTR("stop"));
+			if(httpPostEnd() == FAIL)	break;//nothing was sent, no reply will come
+			return CONNECTION_HTTP_RESPONSE;
+		
 		case 1:	ethernetSendTextf(socket, "Pi is %f or cca %d\r\n", 3.141, 3); return CONNECTION_KEEP_ALIVE;
 		case 2: ethernetSendData(socket, "Hello Server World!!!\r\n", CALCULATE_LENGTH);return CONNECTION_KEEP_ALIVE;
+		
+		default:
+			return CONNECTION_CLOSE;
 	}
+	STATS_ADD(socket, sendFailed, 1);//only failed POSTs get here
 	return CONNECTION_CLOSE;
 }
 
@@ -561,8 +1074,46 @@ unsigned char clientProcessReceivedData(unsigned char socket, char data[], unsig
 	}
 }
 
+void ethernetSetResponseHook(unsigned char (*hook)(unsigned long *command, const httpResponse *response))
+{
+	clientResponseHook = hook;
+}
+
+//complete response to *command, the hook may chain the next command on the same connection
+unsigned char clientProcessHTTPResponse(httpResponse *response, unsigned long *command)
+{
+	if(response->status < 200 || response->status > 299)	return CONNECTION_CLOSE;//request refused
+	if(clientResponseHook)	return clientResponseHook(command, response);//response->body holds the answer of the server
+	
+	return CONNECTION_CLOSE;//transaction done
+}
+
+unsigned char clientReceiveHTTPResponse(unsigned char socket, httpResponse *response, unsigned long *command)
+{
+	switch(httpResponseReceive(socket, response))
+	{
+		case HTTP_COMPLETE:
+			if(clientProcessHTTPResponse(response, command) == CONNECTION_CLOSE || !response->keepAlive)	return CONNECTION_CLOSE;
+			return CONNECTION_KEEP_ALIVE;//next command can go out right away
+		case HTTP_ERROR:
+			return CONNECTION_CLOSE;
+	}
+	return CONNECTION_HTTP_RESPONSE;//rest of the response did not arrive yet
+}
+
+void clientClosedHTTPResponse(unsigned char socket, httpResponse *response, unsigned long *command)
+{
+	httpResponseReceive(socket, response);//data received together with FIN
+	if(httpResponseClosed(response) == HTTP_COMPLETE)//body without Content-Length
+	{
+		clientProcessHTTPResponse(response, command);
+	}
+}
+
 void TCPclient(unsigned char socket, unsigned int sourceSocketPort, IPaddressAndPort server, unsigned long command)
 {
+	httpResponse response;
+	unsigned char result, expectHTTP=0;
 	char RXbuffer[RX_BUFFER_SIZE];
 	unsigned int i, length;
 	unsigned int timeout=0;
@@ -574,18 +1125,42 @@ void TCPclient(unsigned char socket, unsigned int sourceSocketPort, IPaddressAnd
 	
 	while(1)
 	{
+		STATS_LOOP_START(loopStart);
+		
 		if(ethernetIsEstablished(socket) == OK)
 		{
+			STATS_CONNECTED(socket);
 			if(dataSent == 0)
 			{
 				dataSent++;
-				if(clientSendCommand(socket, command) == CONNECTION_CLOSE)
+				result = clientSendCommand(socket, command);
+				if(result == CONNECTION_CLOSE)
 				{
 					ethernetSocketDisconnect(socket);
 				}
+				else if(result == CONNECTION_HTTP_RESPONSE)
+				{
+					httpResponseInit(&response);
+					expectHTTP = 1;
+				}
 			}
 			
-			if(ethernetCheckIfReceivedData(socket) == OK)
+			if(expectHTTP && ethernetCheckIfReceivedData(socket) == OK)
+			{
+				timeout = 0;
+				result = clientReceiveHTTPResponse(socket, &response, &command);
+				if(result == CONNECTION_CLOSE)
+				{
+					expectHTTP = 0;
+					ethernetSocketDisconnect(socket);
+				}
+				else if(result == CONNECTION_KEEP_ALIVE)
+				{
+					expectHTTP = 0;
+					dataSent = 0;//connection is reused for the next command
+				}
+			}
+			else if(!expectHTTP && ethernetCheckIfReceivedData(socket) == OK)
 			{
 				for(i=0; i<RX_BUFFER_SIZE; i++)		RXbuffer[i] = 0;//clear buffer
 				timeout = 0;
@@ -605,17 +1180,305 @@ void TCPclient(unsigned char socket, unsigned int sourceSocketPort, IPaddressAnd
 
 		if(ethernetCheckIfFINreceived(socket) == OK)
 		{
+			if(expectHTTP)	clientClosedHTTPResponse(socket, &response, &command);
+			expectHTTP = 0;
 			ethernetSocketDisconnect(socket);
 		}
 
 		if(ethernetCheckIfCloseOrTimeout(socket) == OK  || (timeout > WAIT_FOR_DATA_RECEIVE))//try 10000 times to connect, then close socket
 		{
+			if(timeout > WAIT_FOR_DATA_RECEIVE)	STATS_ADD(socket, timeouts, 1);
+			STATS_DISCONNECTED(socket);
 			ethernetSocketDisconnect(socket);
 			ethernetSocketClose(socket);//close this socket
+			STATS_LOOP_END(socket, loopStart);
 			return;
 		}
 		
+		STATS_LOOP_END(socket, loopStart);
 		timeout++;
 		_delay_us(100);//for timeout recognition 
 	}
 }
+
+unsigned char TCPserverTask(task *t)
+{
+	TCPserverTaskData *server = t->arg;
+	char RXbuffer[RX_BUFFER_SIZE];
+	unsigned int length;
+	unsigned char status, result;
+	STATS_LOOP_START(loopStart);
+	
+	TASK_BEGIN(t);
+	while(1)
+	{
+		STATS_DISCONNECTED(server->socket);
+		websocketClosed(server->socket);
+		ethernetSocketDisconnect(server->socket);
+		ethernetSocketClose(server->socket);//close this socket
+		if(TCPserverInit(server->socket, server->socketPort) == FAIL)//open and listen to this socket on this port
+		{
+			TASK_SLEEP(t, 1);
+			continue;
+		}
+		
+		TASK_WAIT_UNTIL(t, ethernetGetStatus(server->socket) != SOCK_LISTEN);
+		server->lastActivity = schedulerTicks();
+		
+		while(1)
+		{
+			status = ethernetGetStatus(server->socket);
+			if(status == SOCK_ESTABLISHED)
+			{
+				STATS_CONNECTED(server->socket);
+				if(ethernetCheckIfReceivedData(server->socket) == OK)
+				{
+					if(websocketIsOpen(server->socket) == YES)
+					{
+						server->lastActivity = schedulerTicks();
+						if(websocketReceive(server->socket) == CONNECTION_CLOSE)	ethernetSocketDisconnect(server->socket);
+						STATS_LOOP_END(server->socket, loopStart);
+						TASK_YIELD(t);
+						continue;
+					}
+					if(frameWaiting(server->socket) == YES)
+					{
+						result = frameReceive(server->socket);
+						if(result == CONNECTION_CLOSE)	ethernetSocketDisconnect(server->socket);
+						if(result != CONNECTION_PARTIAL)
+						{
+							server->lastActivity = schedulerTicks();
+							STATS_LOOP_END(server->socket, loopStart);
+							TASK_YIELD(t);
+							continue;
+						}
+						//start of a frame alone is no activity, it polls into the timeout below like an idle connection
+					}
+					else
+					{
+						server->lastActivity = schedulerTicks();
+						length = ethernetSocketReceiveBuffer(server->socket, RXbuffer, RX_BUFFER_SIZE);
+						if(serverProcessReceivedData(server->socket, RXbuffer, length) == CONNECTION_CLOSE)
+						{
+							ethernetSocketDisconnect(server->socket);
+						}
+						STATS_LOOP_END(server->socket, loopStart);
+						TASK_YIELD(t);
+						continue;
+					}
+				}
+			}
+			else if(status == SOCK_CLOSE_WAIT)
+			{
+				ethernetSocketDisconnect(server->socket);
+			}
+			else if(status == SOCK_CLOSED)
+			{
+				break;
+			}
+			
+			if(TICKS_ELAPSED(server->lastActivity) > WAIT_FOR_DATA_RECEIVE && websocketIsOpen(server->socket) == NO)
+			{
+				STATS_ADD(server->socket, timeouts, 1);
+				break;
+			}
+			STATS_LOOP_END(server->socket, loopStart);
+			TASK_POLL(t);
+		}
+	}
+	TASK_END(t);
+}
+
+unsigned char TCPclientTask(task *t)
+{
+	TCPclientTaskData *client = t->arg;
+	char RXbuffer[RX_BUFFER_SIZE];
+	unsigned int length;
+	unsigned char result;
+	address ip;
+	STATS_LOOP_START(loopStart);
+	
+	TASK_BEGIN(t);
+	if(client->host)
+	{
+		TASK_WAIT_UNTIL(t, (result = dnsResolve(client->host, &ip)) != DNS_PENDING);//no query while the cached answer is valid
+		if(result == DNS_FAILED)	TASK_EXIT(t);
+		client->server.b0 = ip.b0;
+		client->server.b1 = ip.b1;
+		client->server.b2 = ip.b2;
+		client->server.b3 = ip.b3;
+	}
+	
+	if(ethernetSocketOpen(client->socket, client->sourceSocketPort) == FAIL)	TASK_EXIT(t);//check if opening socket was successful
+	
+	ethernetSocketConnect(client->socket, client->server);//connect to server
+	client->dataSent = 0;
+	client->expectHTTP = 0;
+	client->lastActivity = schedulerTicks();
+	
+	while(1)
+	{
+		if(ethernetIsEstablished(client->socket) == OK)
+		{
+			STATS_CONNECTED(client->socket);
+			if(client->dataSent == 0)
+			{
+				client->dataSent++;
+				result = clientSendCommand(client->socket, client->command);
+				if(result == CONNECTION_CLOSE)
+				{
+					ethernetSocketDisconnect(client->socket);
+				}
+				else if(result == CONNECTION_HTTP_RESPONSE)
+				{
+					httpResponseInit(&client->response);
+					client->expectHTTP = 1;
+				}
+			}
+			
+			if(client->expectHTTP && ethernetCheckIfReceivedData(client->socket) == OK)
+			{
+				client->lastActivity = schedulerTicks();
+				result = clientReceiveHTTPResponse(client->socket, &client->response, &client->command);
+				if(result == CONNECTION_CLOSE)
+				{
+					client->expectHTTP = 0;
+					ethernetSocketDisconnect(client->socket);
+				}
+				else if(result == CONNECTION_KEEP_ALIVE)
+				{
+					client->expectHTTP = 0;
+					client->dataSent = 0;//connection is reused for the next command
+				}
+				STATS_LOOP_END(client->socket, loopStart);
+				TASK_YIELD(t);
+				continue;
+			}
+			else if(!client->expectHTTP && ethernetCheckIfReceivedData(client->socket) == OK)
+			{
+				client->lastActivity = schedulerTicks();
+				
+				length = ethernetSocketReceiveBuffer(client->socket, RXbuffer, RX_BUFFER_SIZE);
+				
+				if(clientProcessReceivedData(client->socket, RXbuffer, length, &client->command) == CONNECTION_CLOSE)
+				{
+					ethernetSocketDisconnect(client->socket);
+				}
+				else
+				{
+					client->dataSent = 0;//ensures new command will be sent in next pass
+				}
+				STATS_LOOP_END(client->socket, loopStart);
+				TASK_YIELD(t);
+				continue;
+			}
+		}
+		
+		if(ethernetCheckIfFINreceived(client->socket) == OK)
+		{
+			if(client->expectHTTP)	clientClosedHTTPResponse(client->socket, &client->response, &client->command);
+			client->expectHTTP = 0;
+			ethernetSocketDisconnect(client->socket);
+		}
+		
+		if(ethernetCheckIfCloseOrTimeout(client->socket) == OK  || TICKS_ELAPSED(client->lastActivity) > WAIT_FOR_DATA_RECEIVE)
+		{
+			if(TICKS_ELAPSED(client->lastActivity) > WAIT_FOR_DATA_RECEIVE)	STATS_ADD(client->socket, timeouts, 1);
+			STATS_DISCONNECTED(client->socket);
+			ethernetSocketDisconnect(client->socket);
+			ethernetSocketClose(client->socket);//close this socket
+			STATS_LOOP_END(client->socket, loopStart);
+			TASK_EXIT(t);
+		}
+		STATS_LOOP_END(client->socket, loopStart);
+		TASK_POLL(t);
+	}
+	TASK_END(t);
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+//Performance counters
+
+#if ETHERNET_STATS
+static void ethernetStatsSPI(unsigned char block, unsigned int bytes)
+{
+	if(block)//socket register or buffer block, common registers go to total only
+	{
+		ethernetStats[block >> 2].spiTransactions++;
+		ethernetStats[block >> 2].spiBytes += bytes;
+	}
+	ethernetStatsTotal.spiTransactions++;
+	ethernetStatsTotal.spiBytes += bytes;
+}
+
+static void ethernetStatsConnected(unsigned char socket)
+{
+	if(!(ethernetStatsEstablished & (1 << (socket >> 2))))
+	{
+		ethernetStatsEstablished |= (1 << (socket >> 2));
+		STATS_ADD(socket, connects, 1);
+	}
+}
+
+static void ethernetStatsLoop(unsigned char socket, unsigned int start)
+{
+	unsigned int ticks = (uint16_t)(ETHERNET_STATS_TIMER() - start);//16 bit timer overflow
+	
+	if(ticks > ethernetStats[socket >> 2].maxLoopTicks)	ethernetStats[socket >> 2].maxLoopTicks = ticks;
+	if(ticks > ethernetStatsTotal.maxLoopTicks)	ethernetStatsTotal.maxLoopTicks = ticks;
+}
+
+void ethernetStatsInit(void)
+{
+	ETHERNET_STATS_TIMER_INIT();
+	ethernetStatsReset();
+}
+
+void ethernetStatsReset(void)
+{
+	memset(ethernetStats, 0, sizeof(ethernetStats));
+	memset(&ethernetStatsTotal, 0, sizeof(ethernetStatsTotal));
+	ethernetStatsEstablished = 0;
+}
+
+void sendStatsJSONobject(ethernetStatistics *stats, char *end)//into the open stream
+{
+	ethernetStatistics copy = *stats;//counters change while sending
+	
+	ethernetStreamf("{\"bytesRX\":%lu,\"bytesTX\":%lu,\"send\":%lu,\"spiTransactions\":%lu,\"spiBytes\":%lu,",
+		copy.bytesRX, copy.bytesTX, copy.sendCommands, copy.spiTransactions, copy.spiBytes);
+	ethernetStreamf("\"connects\":%u,\"timeouts\":%u,\"bufferFull\":%u,\"sendFailed\":%u,\"maxLoopTicks\":%u}%s",
+		copy.connects, copy.timeouts, copy.bufferFull, copy.sendFailed, copy.maxLoopTicks, end);
+}
+
+void sendStatsJSON(unsigned char socket)//whole reply in one SEND
+{
+	unsigned char i;
+	
+	if(ethernetStreamBegin(socket) == FAIL)	return;
+	ethernetStreamText(PSTR("HTTP/1.0 200 OK\r\nContent-Type: application/json\r\n\r\n{\"sockets\":["));
+	for(i=0; i<8; i++)
+	{
+		sendStatsJSONobject(&ethernetStats[i], (i < 7) ? "," : "],\"total\":");
+	}
+	sendStatsJSONobject(&ethernetStatsTotal, "}\r\n");
+	ethernetStreamEnd();
+}
+
+void ethernetPrintStats(void)
+{
+	char line[128];
+	unsigned char i;
+	ethernetStatistics copy;
+	
+	for(i=0; i<9; i++)
+	{
+		copy = (i < 8) ? ethernetStats[i] : ethernetStatsTotal;
+		snprintf(line, sizeof(line), "%c rx=%lu tx=%lu send=%lu spi=%lu/%luB conn=%u tmo=%u full=%u fail=%u loop=%u\r\n",
+			(i < 8) ? ('0' + i) : 'T', copy.bytesRX, copy.bytesTX, copy.sendCommands, copy.spiTransactions, copy.spiBytes,
+			copy.connects, copy.timeouts, copy.bufferFull, copy.sendFailed, copy.maxLoopTicks);
+		sendString(line);
+	}
+}
+#endif
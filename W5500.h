@@ -27,6 +27,9 @@
 #ifndef W5500_H_
 #define W5500_H_
 
+#include "Scheduler.h"
+#include "HTTP.h"
+
 #define F_CPU 32000000UL
 
 #define FAIL				0
@@ -62,6 +65,40 @@ typedef struct structure5
 	unsigned char b5;
 }MACaddress;
 
+typedef struct structure3
+{
+	unsigned long bytesRX;
+	unsigned long bytesTX;
+	unsigned long sendCommands;
+	unsigned long spiTransactions;//CS cycles
+	unsigned long spiBytes;//including address and control phase
+	unsigned int connects;
+	unsigned int timeouts;
+	unsigned int bufferFull;//received data filled RX_BUFFER_SIZE
+	unsigned int sendFailed;//request did not fit into the TX buffer, connection closed
+	unsigned int maxLoopTicks;//longest TCPserver call / TCPclient loop pass in ETHERNET_STATS_TIMER() ticks
+}ethernetStatistics;
+
+typedef struct structure7
+{
+	unsigned char socket;
+	unsigned int socketPort;
+	unsigned int lastActivity;//schedulerTicks() of connect or last received data
+}TCPserverTaskData;
+
+typedef struct structure8
+{
+	unsigned char socket;
+	unsigned int sourceSocketPort;
+	IPaddressAndPort server;
+	const char *host;//DNS name of the server, NULL = server IP is used as it is, socketPort always
+	unsigned long command;
+	unsigned int lastActivity;
+	unsigned char dataSent;
+	unsigned char expectHTTP;
+	httpResponse response;
+}TCPclientTaskData;
+
 
 
 
@@ -93,13 +130,40 @@ typedef struct structure5
 
 
 #define RX_BUFFER_SIZE	1024UL //in bytes
+#define PIPELINE_BUFFER_SIZE	520	//ethernetSocketReceivePipelined: two Modbus ADUs or two binary frames, one RX and one TX buffer shared by both protocols
 #define WAIT_FOR_DATA_RECEIVE	10000	//how long is the connection open before timeout occurs (cca in milliseconds) //max 65535
 
 #define CONNECTION_KEEP_ALIVE	0x16
 #define CONNECTION_CLOSE		0x17
+#define CONNECTION_HTTP_RESPONSE	0x18	//keep alive, answer is parsed as HTTP response (clientSendCommand)
+#define CONNECTION_PARTIAL		0x19	//keep alive, nothing consumed - only the start of a packet is in RX, do not count it as activity
+
+//ethernetLinkMonitor events
+#define LINK_UNCHANGED			0
+#define LINK_DOWN				1
+#define LINK_UP					2	//connected TCP sockets were closed
+#define LINK_POLL_INTERVAL		100	//ms, PHYCFGR read by ethernetLinkTask
 
 #define CALCULATE_LENGTH		0xFFFF
 
+//HTTP CLIENT (clientSendCommand)
+#define CLIENT_HOST				"server0.pi-chacka.tipa.eu:28080"
+#define CLIENT_SERVER_NAME		"server0.pi-chacka.tipa.eu"	//TCPclientTaskData.host, resolved by dnsTask
+#define CLIENT_SERVER_PORT		28080
+#define CLIENT_PATH				"/connect/recive"
+#define CLIENT_HOSTNAME			"terminal2"
+#ifndef CLIENT_PASSWORD
+#define CLIENT_PASSWORD			""	//set per device with -DCLIENT_PASSWORD=\"...\", no secret in the sources
+#endif
+
+//PERFORMANCE COUNTERS
+//1 = counters, /stats route and ethernetPrintStats(), the feature claims timer TCC0 for loop latency
+#ifndef ETHERNET_STATS
+#define ETHERNET_STATS			0	//0 = everything above compiles to nothing, TCC0 stays free
+#endif
+#define ETHERNET_STATS_TIMER()	(TCC0_CNT)	//free running 16 bit timer used for loop latency
+#define ETHERNET_STATS_TIMER_INIT()	{TCC0_PER = 0xFFFF; TCC0_CTRLA = TC_CLKSEL_DIV64_gc;}	//2 us per tick at 32 MHz, called from ethernetStatsInit
+
 
 
 
@@ -112,6 +176,30 @@ typedef struct structure5
 #define SIPR			0x000F   // Source IP Address: 0x000F to 0x0012
 #define RMSR			0x001A   // RX Memory Size Register
 #define TMSR			0x001B   // TX Memory Size Register
+#define PHYCFGR			0x002E   // PHY Configuration Register
+#define VERSIONR		0x0039   // Chip Version Register
+
+// MR
+#define MR_RST			0x80	// software reset, self clearing
+
+// PHYCFGR
+#define PHYCFGR_RST		0x80	// 0 = PHY reset, must be set to 1 again
+#define PHYCFGR_OPMD	0x40	// 1 = operation mode from OPMDC bits, 0 = from PMODE pins
+#define PHYCFGR_DPX		0x04	// 1 = full duplex
+#define PHYCFGR_SPD		0x02	// 1 = 100 Mbps
+#define PHYCFGR_LNK		0x01	// 1 = link up
+
+// PHY operation modes for ethernetSetPHYmode (OPMDC bits)
+#define PHY_MODE_10_HALF		0x00
+#define PHY_MODE_10_FULL		0x08
+#define PHY_MODE_100_HALF		0x10
+#define PHY_MODE_100_FULL		0x18	// no auto-negotiation, partner must be forced too
+#define PHY_MODE_100_HALF_AUTO	0x20
+#define PHY_MODE_POWER_DOWN		0x30
+#define PHY_MODE_AUTO			0x38	// all capable, auto-negotiation
+
+#define W5500_VERSION			0x04	// VERSIONR
+#define W5500_RESET_TIMEOUT		20		// x 100 us for VERSIONR to answer after reset
 
 
 // Wiznet W5500 Register Addresses SOCKET REGISTER
@@ -125,11 +213,13 @@ typedef struct structure5
 #define Sn_DIPR0		0x000C
 #define Sn_DPORT0		0x0010
 #define Sn_DPORT1		0x0011
+#define Sn_KPALVTR		0x002F //keep alive timer, units of 5 s, 0 = off
 
 
 // Sn_PORT
 // commands for SOCKET REGISTER
 #define Sn_MR_TCP		0b00000001 // TCP mode
+#define Sn_MR_UDP		0b00000010 // UDP mode
 #define Sn_CR_OPEN		0x01 // open port, p69
 #define Sn_CR_LISTEN	0x02
 #define Sn_CR_CONNECT	0x04
@@ -185,9 +275,93 @@ typedef struct structure5
 
 void ethernetInit(address IPaddress, address mask, address gateway, MACaddress MACadr);//set IP, Mask, Gateway and MAC address
 
+//Chip and PHY
+
+unsigned char ethernetHardwareReset(void);//RSTn pulse and MR reset, FAIL if VERSIONR does not read W5500_VERSION
+unsigned char ethernetGetPHYstatus(void);//PHYCFGR, see PHYCFGR_LNK, PHYCFGR_SPD, PHYCFGR_DPX
+void ethernetSetPHYmode(unsigned char mode);//PHY_MODE_*, the link goes down while the PHY restarts
+unsigned char ethernetLinkMonitor(void);//LINK_UP/LINK_DOWN on change (the first call only reads the state), on link up every connected TCP socket is closed
+void ethernetSetLinkHook(void (*hook)(unsigned char event, unsigned char phy));//called by ethernetLinkMonitor on LINK_UP/LINK_DOWN
+unsigned char ethernetLinkTask(task *t);//ethernetLinkMonitor every LINK_POLL_INTERVAL, arg unused
+
+//Register access, block = SOCn_REG for socket registers, 0 for common registers
+
+void ethernetTXdata8(unsigned int address, unsigned char block, unsigned char data);
+unsigned char ethernetRXdata8(unsigned int address, unsigned char block);
+unsigned int ethernetRXdata16(unsigned char lsbAddr, unsigned char socket);
+void ethernetTXdata16(unsigned char lsbAddr, unsigned char socket, unsigned int data);
+
+//Socket layer, socket = SOCn_REG
+
+unsigned char ethernetGetStatus(unsigned char socket);
+void ethernetSetStatus(unsigned char socket, unsigned char data);
+unsigned char ethernetIsEstablished(unsigned char socket);
+unsigned char ethernetCheckIfReceivedData(unsigned char socket);
+unsigned int ethernetSocketReceiveData(unsigned char socket, char data[]);
+unsigned int ethernetSocketReceiveBuffer(unsigned char socket, char data[], unsigned int size);//at most size - 1 bytes + '\0', no UART echo, rest stays in RX
+unsigned int ethernetSocketPeekData(unsigned char socket, char data[], unsigned int size);//copy received data without removing it, returns bytes copied
+void ethernetSocketConsume(unsigned char socket, unsigned int length);//remove bytes already peeked
+//length-prefixed binary protocols: complete requests waiting in RX are handled in one pass, their responses go out in as few SENDs as fit into PIPELINE_BUFFER_SIZE
+//requestLength gets headerSize bytes and returns the whole request length, 0 on lost framing; process returns the response length (0 = none, up to maxResponse)
+//CONNECTION_CLOSE on lost framing, CONNECTION_KEEP_ALIVE if requests were consumed, CONNECTION_PARTIAL if only the start of one is waiting
+unsigned char ethernetSocketReceivePipelined(unsigned char socket, unsigned int headerSize, unsigned int maxResponse, unsigned int (*requestLength)(const unsigned char header[]), unsigned int (*process)(const unsigned char request[], unsigned int length, unsigned char response[]));
+void ethernetSendData(unsigned char socket, char data[], unsigned int length);
+void ethernetSendText(unsigned char socket, const char data[]);
+void ethernetSendTextf(unsigned char socket, char *data, ...);
+unsigned char ethernetCheckIfFINreceived(unsigned char socket);
+unsigned char ethernetCheckIfCloseOrTimeout(unsigned char socket);
+void ethernetSocketDisconnect(unsigned char socket);
+void ethernetSocketClose(unsigned char socket);
+unsigned char ethernetSocketOpen(unsigned char socket, unsigned int socketPort);
+unsigned char ethernetSocketListen(unsigned char socket);
+void ethernetPrintSocketStatus(unsigned char socket);
+void ethernetSocketConnect(unsigned char socket, IPaddressAndPort server);//Write IP address and server port
+unsigned char TCPserverInit(unsigned char socket, unsigned int socketPort);//open and listen
+
+//UDP - every SEND is one datagram, every received datagram starts with an 8 byte header in the RX buffer
+
+unsigned char ethernetSocketOpenUDP(unsigned char socket, unsigned int socketPort);
+void ethernetSendDataTo(unsigned char socket, IPaddressAndPort destination, char data[], unsigned int length);
+unsigned int ethernetSocketReceiveDatagram(unsigned char socket, IPaddressAndPort *source, char data[], unsigned int size);//one datagram, rest of a longer one is dropped, returns bytes copied
+
+//Streaming TX - bytes go straight into the socket TX buffer, one SEND at ethernetStreamEnd
+//Begin/End FAIL if the TX buffer is full or the data did not fit into it (nothing is sent then)
+
+unsigned char ethernetStreamBegin(unsigned char socket);
+void ethernetStreamByte(char data);
+void ethernetStreamText(const char data[]);//string in flash (PSTR)
+void ethernetStreamString(const char data[]);//string in RAM
+void ethernetStreamf(const char format[], ...);//printf into the stream, 128 characters max
+unsigned int ethernetStreamPosition(void);//bytes written since ethernetStreamBegin
+void ethernetStreamPatch(unsigned int position, const char data[], unsigned int length);//overwrite bytes already written
+unsigned char ethernetStreamEnd(void);
+
+//Streaming RX - every received byte goes to consume() without copying, until it returns FAIL
+//bytes after that stay in the RX buffer for the next call, returns number of bytes consumed
+
+unsigned int ethernetSocketReceiveStream(unsigned char socket, unsigned char (*consume)(void *context, char data), void *context);
+
 //TCP server and client
 
 void TCPserver(unsigned char socket, unsigned int socketPort);
 void TCPclient(unsigned char socket, unsigned int sourceSocketPort, IPaddressAndPort server, unsigned long command);
+void ethernetSetResponseHook(unsigned char (*hook)(unsigned long *command, const httpResponse *response));//complete 2xx response to an HTTP command, set *command and return CONNECTION_KEEP_ALIVE to send it on the same connection
+
+//TCP server and client as scheduler tasks, WAIT_FOR_DATA_RECEIVE is in scheduler ticks (ms)
+//arg of the task: TCPserverTaskData / TCPclientTaskData with socket, ports and command filled in
+//TCPserverTask runs forever, TCPclientTask ends after one transaction
+//TCPclientTask with host set needs dnsTask running, the name is looked up in the DNS cache before every connect
+
+unsigned char TCPserverTask(task *t);
+unsigned char TCPclientTask(task *t);
+
+#if ETHERNET_STATS
+extern ethernetStatistics ethernetStats[8];//per socket, index = socket number 0..7
+extern ethernetStatistics ethernetStatsTotal;//all sockets and common register traffic
+
+void ethernetStatsInit(void);//call once at start up, starts TCC0 and clears the counters
+void ethernetStatsReset(void);
+void ethernetPrintStats(void);//dump over UART
+#endif
 
 #endif /* W5500_H_ */
\ No newline at end of file
@@ -0,0 +1,458 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   WebSocket server (RFC 6455) for Wiznet W5500 library for AVR XMEGA
+ * @verbatim
+	Upgrade handshake (SHA-1 + base64), masked frame decoding, ping/pong, push of text frames
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "W5500.h"
+#include "HTTP.h"
+#include "WebSocket.h"
+
+#define WS_OPCODE		0
+#define WS_LENGTH		1
+#define WS_EXTENDED		2
+#define WS_MASK			3
+#define WS_PAYLOAD		4
+#define WS_COMPLETE		5
+
+#define WS_KEY_SIZE		24	//base64 of 16 random bytes
+#define WS_ACCEPT_SIZE	28	//base64 of 20 byte SHA-1
+
+
+typedef struct
+{
+	uint32_t h[5];
+	unsigned char block[64];
+	unsigned char blockLength;
+	unsigned long length;//bytes hashed
+}sha1Context;
+
+
+//Private prototypes
+
+void sha1Init(sha1Context *sha);
+void sha1Block(sha1Context *sha);
+void sha1Byte(sha1Context *sha, unsigned char data);
+void sha1Final(sha1Context *sha, unsigned char digest[20]);
+void base64Encode(const unsigned char data[], unsigned char length, char out[]);
+websocketConnection *websocketFind(unsigned char socket);
+void websocketFrameStart(websocketConnection *connection);
+unsigned char websocketByte(void *context, char data);
+unsigned char websocketFrame(websocketConnection *connection);
+void websocketSendClose(unsigned char socket, unsigned int code);
+
+
+static const char websocketGUID[] PROGMEM = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+static const char base64Table[] PROGMEM = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static websocketConnection websockets[WEBSOCKET_CONNECTIONS] = {[0 ... WEBSOCKET_CONNECTIONS-1] = {.socket = WEBSOCKET_NO_SOCKET}};
+
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+//SHA-1 and base64, only what the handshake needs
+
+#define ROTL32(value, bits)	(((value) << (bits)) | ((value) >> (32 - (bits))))
+
+void sha1Init(sha1Context *sha)
+{
+	sha->h[0] = 0x67452301UL;
+	sha->h[1] = 0xEFCDAB89UL;
+	sha->h[2] = 0x98BADCFEUL;
+	sha->h[3] = 0x10325476UL;
+	sha->h[4] = 0xC3D2E1F0UL;
+	sha->blockLength = 0;
+	sha->length = 0;
+}
+
+void sha1Block(sha1Context *sha)
+{
+	uint32_t w[16];//message schedule kept as 16 word ring
+	uint32_t a, b, c, d, e, f, k, temp;
+	unsigned char i;
+	
+	for(i=0; i<16; i++)
+	{
+		w[i] = ((uint32_t)sha->block[i*4] << 24) | ((uint32_t)sha->block[i*4+1] << 16) | ((uint32_t)sha->block[i*4+2] << 8) | sha->block[i*4+3];
+	}
+	
+	a = sha->h[0];
+	b = sha->h[1];
+	c = sha->h[2];
+	d = sha->h[3];
+	e = sha->h[4];
+	
+	for(i=0; i<80; i++)
+	{
+		if(i >= 16)
+		{
+			temp = w[(i+13) & 15] ^ w[(i+8) & 15] ^ w[(i+2) & 15] ^ w[i & 15];
+			w[i & 15] = ROTL32(temp, 1);
+		}
+		
+		if(i < 20)		{f = (b & c) | (~b & d);			k = 0x5A827999UL;}
+		else if(i < 40)	{f = b ^ c ^ d;						k = 0x6ED9EBA1UL;}
+		else if(i < 60)	{f = (b & c) | (b & d) | (c & d);	k = 0x8F1BBCDCUL;}
+		else			{f = b ^ c ^ d;						k = 0xCA62C1D6UL;}
+		
+		temp = ROTL32(a, 5) + f + e + k + w[i & 15];
+		e = d;
+		d = c;
+		c = ROTL32(b, 30);
+		b = a;
+		a = temp;
+	}
+	
+	sha->h[0] += a;
+	sha->h[1] += b;
+	sha->h[2] += c;
+	sha->h[3] += d;
+	sha->h[4] += e;
+	sha->blockLength = 0;
+}
+
+void sha1Byte(sha1Context *sha, unsigned char data)
+{
+	sha->block[sha->blockLength++] = data;
+	sha->length++;
+	if(sha->blockLength == 64)	sha1Block(sha);
+}
+
+void sha1Final(sha1Context *sha, unsigned char digest[20])
+{
+	unsigned long bits = sha->length << 3;
+	unsigned char i;
+	
+	sha->block[sha->blockLength++] = 0x80;
+	if(sha->blockLength > 56)
+	{
+		while(sha->blockLength < 64)	sha->block[sha->blockLength++] = 0;
+		sha1Block(sha);
+	}
+	while(sha->blockLength < 60)	sha->block[sha->blockLength++] = 0;//upper 32 bits of the length are always 0 here
+	for(i=0; i<4; i++)	sha->block[60+i] = bits >> (24 - i*8);
+	sha1Block(sha);
+	
+	for(i=0; i<20; i++)	digest[i] = sha->h[i >> 2] >> (24 - (i & 3)*8);
+}
+
+void base64Encode(const unsigned char data[], unsigned char length, char out[])
+{
+	unsigned long triple;
+	unsigned char i;
+	
+	for(i=0; i<length; i+=3)
+	{
+		triple = (unsigned long)data[i] << 16;
+		if(i+1 < length)	triple |= (unsigned long)data[i+1] << 8;
+		if(i+2 < length)	triple |= data[i+2];
+		
+		*out++ = pgm_read_byte(&base64Table[(triple >> 18) & 0x3F]);
+		*out++ = pgm_read_byte(&base64Table[(triple >> 12) & 0x3F]);
+		*out++ = (i+1 < length) ? pgm_read_byte(&base64Table[(triple >> 6) & 0x3F]) : '=';
+		*out++ = (i+2 < length) ? pgm_read_byte(&base64Table[triple & 0x3F]) : '=';
+	}
+	*out = '\0';
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+//Connections
+
+websocketConnection *websocketFind(unsigned char socket)
+{
+	unsigned char i;
+	
+	for(i=0; i<WEBSOCKET_CONNECTIONS; i++)
+	{
+		if(websockets[i].socket == socket)	return &websockets[i];
+	}
+	return 0;
+}
+
+unsigned char websocketAccept(unsigned char socket, char request[], void (*received)(unsigned char socket, char data[], unsigned int length))
+{
+	websocketConnection *connection = websocketFind(socket);
+	sha1Context sha;
+	unsigned char digest[20];
+	char accept[WS_ACCEPT_SIZE + 1];
+	char *upgrade, *connectionHeader, *key, *version;
+	unsigned char i;
+	
+	upgrade = httpRequestHeader(request, PSTR("upgrade"));
+	connectionHeader = httpRequestHeader(request, PSTR("connection"));
+	key = httpRequestHeader(request, PSTR("sec-websocket-key"));
+	version = httpRequestHeader(request, PSTR("sec-websocket-version"));
+	if(!upgrade || httpContains(upgrade, PSTR("websocket")) == NO || !connectionHeader || httpContains(connectionHeader, PSTR("upgrade")) == NO || !key)
+	{
+		ethernetSendText(socket, PSTR("HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n"));
+		return FAIL;
+	}
+	if(!version || strtoul(version, 0, 10) != 13)//RFC 6455 section 4.4, tell the client the version we speak
+	{
+		ethernetSendText(socket, PSTR("HTTP/1.1 426 Upgrade Required\r\nSec-WebSocket-Version: 13\r\nContent-Length: 0\r\n\r\n"));
+		return FAIL;
+	}
+	
+	if(!connection)	connection = websocketFind(WEBSOCKET_NO_SOCKET);
+	if(!connection)
+	{
+		ethernetSendText(socket, PSTR("HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n"));
+		return FAIL;
+	}
+	
+	sha1Init(&sha);
+	for(i=0; i<WS_KEY_SIZE && key[i] > ' '; i++)	sha1Byte(&sha, key[i]);
+	for(i=0; pgm_read_byte(&websocketGUID[i]); i++)	sha1Byte(&sha, pgm_read_byte(&websocketGUID[i]));
+	sha1Final(&sha, digest);
+	base64Encode(digest, 20, accept);
+	
+	if(ethernetStreamBegin(socket) == FAIL)	return FAIL;
+	ethernetStreamText(PSTR("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: "));
+	ethernetStreamString(accept);
+	ethernetStreamText(PSTR("\r\n\r\n"));
+	if(ethernetStreamEnd() == FAIL)	return FAIL;
+	
+	connection->socket = socket;
+	connection->message = 0;
+	connection->payloadLength = 0;
+	connection->payload[0] = '\0';
+	connection->handler = received;
+	websocketFrameStart(connection);
+	
+	return OK;
+}
+
+unsigned char websocketIsOpen(unsigned char socket)
+{
+	return websocketFind(socket) ? YES : NO;
+}
+
+void websocketClosed(unsigned char socket)
+{
+	websocketConnection *connection = websocketFind(socket);
+	
+	if(connection)	connection->socket = WEBSOCKET_NO_SOCKET;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+//Frames
+
+void websocketFrameStart(websocketConnection *connection)
+{
+	connection->state = WS_OPCODE;
+	connection->closeCode = 0;
+	connection->controlLength = 0;
+}
+
+unsigned char websocketByte(void *context, char data)
+{
+	websocketConnection *connection = context;
+	unsigned char control;
+	
+	switch(connection->state)
+	{
+		case WS_OPCODE:
+			connection->header = data;
+			connection->state = WS_LENGTH;
+			break;
+		
+		case WS_LENGTH:
+			if(!(data & 0x80))	connection->closeCode = 1002;//frames from the client must be masked
+			connection->length = data & 0x7F;
+			connection->state = WS_MASK;
+			connection->maskIndex = 0;
+			if(connection->length == 126)
+			{
+				connection->length = 0;
+				connection->extendedLength = 2;
+				connection->state = WS_EXTENDED;
+			}
+			else if(connection->length == 127)//64 bit length, far more than we can take
+			{
+				connection->closeCode = 1009;
+				connection->state = WS_COMPLETE;
+			}
+			break;
+		
+		case WS_EXTENDED:
+			connection->length = (connection->length << 8) | (unsigned char)data;
+			if(--connection->extendedLength == 0)	connection->state = WS_MASK;
+			break;
+		
+		case WS_MASK:
+			connection->mask[connection->maskIndex++] = data;
+			if(connection->maskIndex < 4)	break;
+		
+			control = connection->header & 0x08;
+			if(control && (connection->length > WEBSOCKET_PAYLOAD_SIZE || !(connection->header & 0x80)))	connection->closeCode = 1002;//control frames are short and never fragmented
+			if(!control && (connection->header & 0x0F) != WEBSOCKET_CONTINUATION)//first frame of a new message
+			{
+				connection->payloadLength = 0;
+				connection->payload[0] = '\0';
+			}
+			connection->received = 0;
+			connection->state = (connection->length && !connection->closeCode) ? WS_PAYLOAD : WS_COMPLETE;
+			break;
+		
+		case WS_PAYLOAD:
+			data ^= connection->mask[connection->received & 3];
+			if(connection->header & 0x08)
+			{
+				connection->control[connection->controlLength++] = data;
+			}
+			else if(connection->payloadLength < WEBSOCKET_PAYLOAD_SIZE)
+			{
+				connection->payload[connection->payloadLength++] = data;
+				connection->payload[connection->payloadLength] = '\0';
+			}
+			else
+			{
+				connection->closeCode = 1009;//message too big, rest of the frame is still consumed
+			}
+			if(++connection->received == connection->length)	connection->state = WS_COMPLETE;
+			break;
+	}
+	
+	return (connection->state == WS_COMPLETE) ? FAIL : OK;
+}
+
+unsigned char websocketFrame(websocketConnection *connection)
+{
+	unsigned char opcode = connection->header & 0x0F;
+	
+	if(connection->closeCode == 0)
+	{
+		switch(opcode)
+		{
+			case WEBSOCKET_TEXT:
+			case WEBSOCKET_BINARY:
+				if(connection->message)	connection->closeCode = 1002;//previous message not finished
+				connection->message = opcode;
+				break;
+			case WEBSOCKET_CONTINUATION:
+				if(!connection->message)	connection->closeCode = 1002;
+				break;
+			case WEBSOCKET_PING:
+				websocketSend(connection->socket, WEBSOCKET_PONG, connection->control, connection->controlLength);
+				return CONNECTION_KEEP_ALIVE;
+			case WEBSOCKET_PONG:
+				return CONNECTION_KEEP_ALIVE;
+			case WEBSOCKET_CLOSE://echo the status code and close
+				websocketSend(connection->socket, WEBSOCKET_CLOSE, connection->control, (connection->controlLength >= 2) ? 2 : 0);
+				return CONNECTION_CLOSE;
+			default:
+				connection->closeCode = 1002;
+				break;
+		}
+	}
+	
+	if(connection->closeCode)
+	{
+		websocketSendClose(connection->socket, connection->closeCode);
+		return CONNECTION_CLOSE;
+	}
+	
+	if(connection->header & 0x80)//FIN, message complete
+	{
+		connection->message = 0;
+		if(connection->handler)	connection->handler(connection->socket, connection->payload, connection->payloadLength);
+		connection->payloadLength = 0;
+	}
+	
+	return CONNECTION_KEEP_ALIVE;
+}
+
+unsigned char websocketReceive(unsigned char socket)
+{
+	websocketConnection *connection = websocketFind(socket);
+	
+	if(!connection)	return CONNECTION_CLOSE;
+	
+	//all complete frames waiting in RX, one ethernetSocketReceiveStream pass per frame
+	//because handlers can send only after the RX frame on the SPI is closed
+	while(ethernetSocketReceiveStream(socket, websocketByte, connection))
+	{
+		if(connection->state != WS_COMPLETE)	break;//rest of the frame did not arrive yet
+		
+		if(websocketFrame(connection) == CONNECTION_CLOSE)
+		{
+			websocketClosed(socket);
+			return CONNECTION_CLOSE;
+		}
+		websocketFrameStart(connection);
+	}
+	
+	return CONNECTION_KEEP_ALIVE;
+}
+
+unsigned char websocketSend(unsigned char socket, unsigned char opcode, const char data[], unsigned int length)
+{
+	unsigned int i;
+	
+	if(!websocketFind(socket) || ethernetStreamBegin(socket) == FAIL)	return FAIL;
+	
+	ethernetStreamByte(0x80 | opcode);//FIN, server frames are never masked
+	if(length < 126)
+	{
+		ethernetStreamByte(length);
+	}
+	else
+	{
+		ethernetStreamByte(126);
+		ethernetStreamByte(length >> 8);
+		ethernetStreamByte(length & 0xFF);
+	}
+	for(i=0; i<length; i++)	ethernetStreamByte(data[i]);
+	
+	return ethernetStreamEnd();
+}
+
+void websocketSendClose(unsigned char socket, unsigned int code)
+{
+	char status[2];
+	
+	status[0] = code >> 8;
+	status[1] = code & 0xFF;
+	websocketSend(socket, WEBSOCKET_CLOSE, status, 2);
+}
+
+unsigned char websocketSendText(unsigned char socket, const char data[])
+{
+	return websocketSend(socket, WEBSOCKET_TEXT, data, strlen(data));
+}
+
+void websocketBroadcastText(const char data[])
+{
+	unsigned char i;
+	
+	for(i=0; i<WEBSOCKET_CONNECTIONS; i++)
+	{
+		if(websockets[i].socket != WEBSOCKET_NO_SOCKET)	websocketSendText(websockets[i].socket, data);
+	}
+}
@@ -0,0 +1,79 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @ide     Atmel Studio 6.2
+ * @license GNU GPL v3
+ * @brief   WebSocket server (RFC 6455) for Wiznet W5500 library for AVR XMEGA
+ * @verbatim
+	Upgrade handshake (SHA-1 + base64), masked frame decoding, ping/pong, push of text frames
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#ifndef WEBSOCKET_H_
+#define WEBSOCKET_H_
+
+#define WEBSOCKET_CONNECTIONS		2	//sockets that can be upgraded at the same time
+#define WEBSOCKET_PAYLOAD_SIZE		125	//longest message kept, also the longest control frame allowed by RFC 6455
+#define WEBSOCKET_KEEP_ALIVE		6	//Sn_KPALVTR of TCPserver sockets, 6 x 5 s - upgraded connections have no idle timeout, the W5500 drops vanished peers
+
+#define WEBSOCKET_CONTINUATION		0x00
+#define WEBSOCKET_TEXT				0x01
+#define WEBSOCKET_BINARY			0x02
+#define WEBSOCKET_CLOSE				0x08
+#define WEBSOCKET_PING				0x09
+#define WEBSOCKET_PONG				0x0A
+
+#define WEBSOCKET_NO_SOCKET			0xFF
+
+
+typedef struct structure10
+{
+	unsigned char socket;//WEBSOCKET_NO_SOCKET = free slot
+	unsigned char state;//frame decoder state
+	unsigned char header;//first byte of the frame - FIN and opcode
+	unsigned char message;//opcode of the message being collected (TEXT/BINARY), continuations are appended
+	unsigned char extendedLength;//bytes of 16 bit extended length still to come
+	unsigned char maskIndex;
+	unsigned char mask[4];
+	unsigned int closeCode;//not 0 = protocol error found, close with this status code
+	unsigned int length;//payload length of the frame
+	unsigned int received;
+	unsigned char controlLength;
+	char control[WEBSOCKET_PAYLOAD_SIZE + 1];//ping/close payload, may arrive between fragments of a message
+	unsigned int payloadLength;
+	char payload[WEBSOCKET_PAYLOAD_SIZE + 1];//always '\0' terminated
+	void (*handler)(unsigned char socket, char data[], unsigned int length);//complete TEXT/BINARY message
+}websocketConnection;
+
+
+//Public prototypes
+
+//serverProcessReceivedData: GET request for the WebSocket path -> websocketAccept(), keep the connection open if OK
+//TCPserver: received data on an upgraded socket -> websocketReceive(), socket closed -> websocketClosed()
+
+unsigned char websocketAccept(unsigned char socket, char request[], void (*received)(unsigned char socket, char data[], unsigned int length));//FAIL after a 400/426/503 reply if the handshake is invalid, not version 13 or no slot is free
+unsigned char websocketIsOpen(unsigned char socket);
+unsigned char websocketReceive(unsigned char socket);//CONNECTION_KEEP_ALIVE or CONNECTION_CLOSE
+void websocketClosed(unsigned char socket);
+
+//Push, one frame and one SEND each, payload up to 65535 bytes, FAIL if not upgraded or TX buffer is full
+unsigned char websocketSend(unsigned char socket, unsigned char opcode, const char data[], unsigned int length);
+unsigned char websocketSendText(unsigned char socket, const char data[]);//string in RAM
+void websocketBroadcastText(const char data[]);//to every upgraded socket
+
+#endif /* WEBSOCKET_H_ */
@@ -0,0 +1,85 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @license GNU GPL v3
+ * @brief   UART-XMEGA.h implementation for host builds
+ * @verbatim
+	UART port for the W5500 model - TX bytes are counted and cost modeled line time
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#include <stdint.h>
+#include "W5500-sim.h"
+#include "UART-XMEGA.h"
+
+
+void UART_init(void)
+{
+}
+
+void UART_TX(unsigned char TX_data)
+{
+	w5500simUARTbyte(TX_data);
+}
+
+unsigned char UART_RX(void)
+{
+	return 0;//nothing is ever received on host
+}
+
+void UART_TX_string(unsigned char* TX_string)
+{
+	while(*TX_string)
+	UART_TX(*TX_string++);
+}
+
+void sendString(char data[])
+{
+	unsigned char i = 0;
+	while (data[i] != '\0')
+	{
+		UART_TX(data[i]);
+		i++;
+	}
+}
+
+void printOctetDec(unsigned char octet)
+{
+	UART_TX(octet / 100 + '0');
+	UART_TX(octet / 10 % 10 + '0');
+	UART_TX(octet % 10 + '0');
+}
+
+void printOctetHex(unsigned char octet)
+{
+	const char hex[] = "0123456789ABCDEF";
+	UART_TX(hex[octet >> 4]);
+	UART_TX(hex[octet & 0x0F]);
+}
+
+char processString(char data[], unsigned char toPrint)
+{
+	unsigned char i = 0;
+	char last = '0';
+	while (data[i] != '\0')
+	{
+		last = data[i];
+		i++;
+	}
+	return last;
+}
@@ -0,0 +1,1123 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @license GNU GPL v3
+ * @brief   Benchmarks of the W5500 library running against the host W5500 model
+ * @verbatim
+	Reports SPI bytes, CS cycles and modeled microseconds per operation
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "W5500-sim.h"
+#include "W5500.h"
+#include "Scheduler.h"
+#include "WebSocket.h"
+#include "Modbus.h"
+#include "MQTT.h"
+#include "DNS.h"
+#include "DHCP.h"
+#include "Frame.h"
+#include <util/delay.h>
+
+
+#define BENCH_ITERATIONS	100
+#define BENCH_MAX_POLLS		100000UL
+#define BENCH_MAX_LATENESS	2	//ms, 10 ms control task next to TCPserverTask
+#define BENCH_CAPTURE_SOCKET	3
+#define BENCH_WS_SOCKET		3
+#define BENCH_MQTT_SOCKET	6
+#define BENCH_FRAME_SOCKET	3
+#define BENCH_FRAMES		10
+
+static const char httpRequest[] = "GET / HTTP/1.1\r\nHost: 192.168.1.4\r\nUser-Agent: bench\r\nAccept: */*\r\n\r\n";
+static const char clientReply[] = "GET\r\n";
+static const char websocketRequest[] = "GET /ws HTTP/1.1\r\nHost: 192.168.1.4\r\nupgrade: WebSocket\r\nconnection: keep-alive, Upgrade\r\nsec-websocket-key: dGhlIHNhbXBsZSBub25jZQ==\r\nSEC-WEBSOCKET-VERSION: 13\r\n\r\n";//header names and tokens are case insensitive
+static const char websocketRequestOld[] = "GET /ws HTTP/1.1\r\nHost: 192.168.1.4\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 8\r\n\r\n";
+static const char websocketAcceptHeader[] = "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n";//RFC 6455 section 1.3 example
+static const char postReply[] = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 15\r\n\r\n{\"status\":\"ok\"}";
+static const char postReplyChunked[] = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nConnection: keep-alive\r\n\r\n7\r\n{\"time\"\r\n14\r\n:\"2018-05-01 12:00\"}\r\n0\r\n\r\n";
+
+static unsigned long long peerRxBytes;
+static unsigned char peerReplied[W5500SIM_SOCKETS];
+static unsigned char peerFailed;
+static unsigned char peerPosts[W5500SIM_SOCKETS];//POST requests on the current connection
+static unsigned char peerCapture[W5500SIM_SOCKETS][2048];//everything sent on sockets >= BENCH_CAPTURE_SOCKET
+static unsigned int peerCaptureLength[W5500SIM_SOCKETS];
+static const char *peerPending;//rest of a reply, delivered when modeled time moves on
+static unsigned char peerPendingSocket;
+static unsigned long brokerSends, brokerPublishes, brokerPubacks, brokerPings;//broker stand-in on BENCH_MQTT_SOCKET
+static unsigned char brokerSubscribed;
+static unsigned char peerConnectIP[4];
+static unsigned long dnsQueries;//received by the DNS server stand-in
+static unsigned int dnsQueryPort;//source port of the last query
+static unsigned char dnsSlow;//DNS server stand-in answers the first attempt only after the retry arrived
+static unsigned char dnsHeld[512];
+static unsigned int dnsHeldLength;
+static unsigned long dhcpMessages;//received by the DHCP server stand-in
+static unsigned char dhcpPool = 50;//last byte of the address the DHCP server leases
+static unsigned char dhcpShortDNS;//DHCP server stand-in appends a 2 byte DNS server option to the next ACK
+static unsigned char dhcpWrongAck;//DHCP server stand-in acknowledges the next REQUEST with another address and router
+
+
+//scripted remote side: accepts immediately, answers first client SEND, closes on FIN
+static void benchConnect(unsigned char socketNumber, const unsigned char ip[4], unsigned int port)
+{
+	peerReplied[socketNumber] = 0;
+	peerPosts[socketNumber] = 0;
+	memcpy(peerConnectIP, ip, 4);
+	w5500simEstablish(socketNumber);
+}
+
+//a POST must arrive in one SEND with Content-Length equal to its body
+//the first one is answered in two parts with Content-Length, the second one chunked on the same connection
+static void benchPost(unsigned char socketNumber, const unsigned char *data, unsigned int length)
+{
+	char request[2048];
+	char *header, *body;
+
+	if(length >= sizeof(request))
+	{
+		peerFailed = 1;
+		return;
+	}
+	memcpy(request, data, length);
+	request[length] = '\0';
+
+	header = strstr(request, "Content-Length:");
+	body = strstr(request, "\r\n\r\n");
+	if(!header || !body || strtoul(header + 15, NULL, 10) != strlen(body + 4))	peerFailed = 1;
+
+	if(peerPosts[socketNumber]++ == 0)
+	{
+		w5500simDeliver(socketNumber, (const unsigned char *)postReply, 40);
+		peerPending = postReply + 40;
+		peerPendingSocket = socketNumber;
+	}
+	else
+	{
+		w5500simDeliver(socketNumber, (const unsigned char *)postReplyChunked, sizeof(postReplyChunked) - 1);
+	}
+}
+
+//MQTT broker stand-in: CONNACK, SUBACK followed by one QoS 1 PUBLISH, PUBACK for QoS 1 publishes, PINGRESP
+static const unsigned char brokerCommand[] = {0x32, 13, 0, 7, 'c', 'm', 'd', '/', 'l', 'e', 'd', 0x12, 0x34, 'o', 'n'};//QoS 1 publish
+
+static void benchBroker(unsigned char socketNumber, const unsigned char *data, unsigned int length)
+{
+	unsigned char reply[5];
+	unsigned int offset, remaining, topicLength;
+
+	brokerSends++;
+	for(offset=0; offset + 2 <= length; offset += 2 + remaining)
+	{
+		remaining = data[offset + 1];
+		if(remaining & 0x80)	remaining = (remaining & 0x7F) | ((unsigned int)data[offset + 2] << 7);//bench packets are shorter than 16 KB
+		if(data[offset + 1] & 0x80)	offset++;
+		if(offset + 2 + remaining > length)
+		{
+			peerFailed = 1;//a packet split over two SENDs
+			return;
+		}
+
+		switch(data[offset] & 0xF0)
+		{
+			case MQTT_CONNECT:
+				if(remaining < 10 || memcmp(data + offset + 4, "MQTT", 4) != 0 || data[offset + 8] != 4)	peerFailed = 1;
+				reply[0] = MQTT_CONNACK;
+				reply[1] = 2;
+				reply[2] = 0;//session present = 0
+				reply[3] = 0;//accepted
+				w5500simDeliver(socketNumber, reply, 4);
+				break;
+
+			case MQTT_SUBSCRIBE & 0xF0:
+				reply[0] = MQTT_SUBACK;
+				reply[1] = 3;
+				reply[2] = data[offset + 2];
+				reply[3] = data[offset + 3];
+				reply[4] = data[offset + 1 + remaining];//granted QoS = requested
+				w5500simDeliver(socketNumber, reply, 5);
+				if(!brokerSubscribed++)	w5500simDeliver(socketNumber, brokerCommand, sizeof(brokerCommand));
+				break;
+
+			case MQTT_PUBLISH:
+				brokerPublishes++;
+				if(data[offset] & 0x02)
+				{
+					topicLength = ((unsigned int)data[offset + 2] << 8) | data[offset + 3];
+					reply[0] = MQTT_PUBACK;
+					reply[1] = 2;
+					reply[2] = data[offset + 4 + topicLength];
+					reply[3] = data[offset + 5 + topicLength];
+					w5500simDeliver(socketNumber, reply, 4);
+				}
+				break;
+
+			case MQTT_PUBACK:
+				if(data[offset + 2] != 0x12 || data[offset + 3] != 0x34)	peerFailed = 1;
+				brokerPubacks++;
+				break;
+
+			case MQTT_PINGREQ:
+				brokerPings++;
+				reply[0] = MQTT_PINGRESP;
+				reply[1] = 0;
+				w5500simDeliver(socketNumber, reply, 2);
+				break;
+
+			default:
+				peerFailed = 1;
+		}
+	}
+}
+
+//DHCP server stand-in: offers and acknowledges 192.168.1.dhcpPool for 120 s, NAK for any other address
+static void benchDHCPserver(unsigned char socketNumber, const unsigned char *data, unsigned int length)
+{
+	static const unsigned char server[4] = {192, 168, 1, 1};
+	static const unsigned char options[] = {51, 4, 0, 0, 0, 120, 1, 4, 255, 255, 255, 0, 3, 4, 192, 168, 1, 1, 6, 4, 192, 168, 1, 1, 255};
+	static const unsigned char shortDNS[] = {6, 2, 10, 0, 255};
+	unsigned char reply[300];
+	unsigned char requested[4] = {0, 0, 0, 0};
+	unsigned char lease[4] = {192, 168, 1, 0};
+	unsigned char type = 0, replyType;
+	unsigned int offset;
+
+	dhcpMessages++;
+	if(length < 240 || data[0] != 1 || memcmp(data + 236, "\x63\x82\x53\x63", 4) != 0)
+	{
+		peerFailed = 1;
+		return;
+	}
+	for(offset=240; offset + 2 <= length && data[offset] != 255; offset += 2 + data[offset + 1])
+	{
+		if(data[offset] == 53)	type = data[offset + 2];
+		if(data[offset] == 50)	memcpy(requested, data + offset + 2, 4);
+	}
+	if(type == DHCP_REQUEST && requested[0] == 0)	memcpy(requested, data + 12, 4);//RENEWING, address in ciaddr
+	lease[3] = dhcpPool;
+
+	memset(reply, 0, sizeof(reply));
+	memcpy(reply, data, 240);//xid, flags, ciaddr, chaddr, magic cookie
+	reply[0] = 2;
+	if(type == DHCP_DISCOVER)							replyType = DHCP_OFFER;
+	else if(type == DHCP_REQUEST && memcmp(requested, lease, 4) == 0)	replyType = DHCP_ACK;
+	else												replyType = DHCP_NAK;
+	if(replyType == DHCP_ACK && dhcpWrongAck)	lease[3]++;
+	if(replyType != DHCP_NAK)	memcpy(reply + 16, lease, 4);//yiaddr
+
+	offset = 240;
+	reply[offset++] = 53;
+	reply[offset++] = 1;
+	reply[offset++] = replyType;
+	reply[offset++] = 54;
+	reply[offset++] = 4;
+	memcpy(reply + offset, server, 4);
+	offset += 4;
+	if(replyType != DHCP_NAK)	memcpy(reply + offset, options, sizeof(options));
+	else						reply[offset] = 255;
+	if(replyType == DHCP_ACK && dhcpShortDNS)
+	{
+		memcpy(reply + offset + sizeof(options) - 1, shortDNS, sizeof(shortDNS));//in place of the end option
+		dhcpShortDNS = 0;
+	}
+	if(replyType == DHCP_ACK && dhcpWrongAck)
+	{
+		reply[offset + 17] = 99;//router
+		dhcpWrongAck = 0;
+	}
+	w5500simDeliverDatagram(socketNumber, server, DHCP_SERVER_PORT, reply, sizeof(reply));
+}
+
+//DNS server stand-in: CLIENT_SERVER_NAME is 192.168.1.20 with TTL 30 s, every other name is NXDOMAIN
+static void benchDatagram(unsigned char socketNumber, const unsigned char ip[4], unsigned int port, const unsigned char *data, unsigned int length)
+{
+	static const unsigned char name[] = "\x07server0\x09pi-chacka\x04tipa\x02" "eu";//root label is the terminating zero
+	static const unsigned char answer[] = {0xC0, 0x0C, 0, 1, 0, 1, 0, 0, 0, 30, 0, 4, 192, 168, 1, 20};//pointer to the question name, A, IN, TTL, address
+	unsigned char reply[512];
+	unsigned char known;
+
+	if(port == DHCP_SERVER_PORT)
+	{
+		benchDHCPserver(socketNumber, data, length);
+		return;
+	}
+	dnsQueries++;
+	if(port != DNS_PORT || length < 12 + 5 || length + sizeof(answer) > sizeof(reply))
+	{
+		peerFailed = 1;
+		return;
+	}
+	known = (length == 12 + sizeof(name) + 4 && memcmp(data + 12, name, sizeof(name)) == 0);
+
+	memcpy(reply, data, length);//header and question
+	reply[2] = 0x81;//response, recursion desired
+	reply[3] = known ? 0x80 : 0x83;//recursion available, NXDOMAIN
+	reply[7] = known;//answer count
+	if(known)	memcpy(reply + length, answer, sizeof(answer));
+	dnsQueryPort = w5500simLocalPort(socketNumber);
+	if(dnsSlow)
+	{
+		if(dnsHeldLength == 0)
+		{
+			dnsHeldLength = length + (known ? sizeof(answer) : 0);
+			memcpy(dnsHeld, reply, dnsHeldLength);
+			return;
+		}
+		w5500simDeliverDatagram(socketNumber, ip, DNS_PORT, dnsHeld, dnsHeldLength);//the retry itself is not answered
+		dnsHeldLength = 0;
+		dnsSlow = 0;
+		return;
+	}
+	w5500simDeliverDatagram(socketNumber, ip, DNS_PORT, reply, length + (known ? sizeof(answer) : 0));
+}
+
+static void benchAdvance(unsigned long long nowNs)
+{
+	const char *pending = peerPending;
+
+	if(pending)
+	{
+		peerPending = NULL;
+		w5500simDeliver(peerPendingSocket, (const unsigned char *)pending, strlen(pending));
+	}
+}
+
+static void benchSend(unsigned char socketNumber, const unsigned char *data, unsigned int length)
+{
+	peerRxBytes += length;
+	if(socketNumber == BENCH_MQTT_SOCKET)
+	{
+		benchBroker(socketNumber, data, length);
+	}
+	else if(socketNumber >= BENCH_CAPTURE_SOCKET)
+	{
+		if(peerCaptureLength[socketNumber] + length <= sizeof(peerCapture[0]))	memcpy(peerCapture[socketNumber] + peerCaptureLength[socketNumber], data, length);
+		peerCaptureLength[socketNumber] += length;
+	}
+	else if(length >= 5 && memcmp(data, "POST ", 5) == 0)
+	{
+		benchPost(socketNumber, data, length);
+	}
+	else if(!peerReplied[socketNumber])
+	{
+		peerReplied[socketNumber] = 1;
+		w5500simDeliver(socketNumber, (const unsigned char *)clientReply, sizeof(clientReply) - 1);
+	}
+}
+
+static void benchDisconnect(unsigned char socketNumber)
+{
+	w5500simRemoteClose(socketNumber);
+}
+
+static const W5500simPeer benchPeer =
+{
+	.connect = benchConnect,
+	.send = benchSend,
+	.disconnect = benchDisconnect,
+	.advance = benchAdvance,
+	.datagram = benchDatagram,
+};
+
+
+static void benchReport(const char *name, unsigned long iterations, W5500simCounters *before)
+{
+	W5500simCounters after;
+
+	w5500simGetCounters(&after);
+	printf("%-28s %6lu %12.1f %10.1f %8.2f %12.1f %10.1f\n", name, iterations,
+		(double)(after.spiBytes - before->spiBytes) / iterations,
+		(double)(after.csCycles - before->csCycles) / iterations,
+		(double)(after.sendCommands - before->sendCommands) / iterations,
+		(double)(after.uartBytes - before->uartBytes) / iterations,
+		(double)(after.modeledNs - before->modeledNs) / 1000.0 / iterations);
+}
+
+static void benchEthernetInit(void)
+{
+	address IPaddress = {IP0, IP1, IP2, IP3};
+	address mask = {MASK0, MASK1, MASK2, MASK3};
+	address gateway = {GW0, GW1, GW2, GW3};
+	MACaddress MACadr = {MAC0, MAC1, MAC2, MAC3, MAC4, MAC5};
+	W5500simCounters before;
+	unsigned long i;
+
+	w5500simGetCounters(&before);
+	for(i=0; i<BENCH_ITERATIONS; i++)
+	{
+		ethernetInit(IPaddress, mask, gateway, MACadr);
+	}
+	benchReport("ethernetInit", BENCH_ITERATIONS, &before);
+}
+
+static void benchServerIdle(void)
+{
+	W5500simCounters before;
+	unsigned long i;
+
+	TCPserver(SOC0_REG, 80);//CLOSED -> LISTEN
+	w5500simGetCounters(&before);
+	for(i=0; i<BENCH_ITERATIONS; i++)
+	{
+		TCPserver(SOC0_REG, 80);
+	}
+	benchReport("TCPserver idle poll", BENCH_ITERATIONS, &before);
+}
+
+static void benchHTTPrequest(void)
+{
+	W5500simCounters before;
+	unsigned long i, polls;
+
+	TCPserver(SOC0_REG, 80);
+	w5500simGetCounters(&before);
+	for(i=0; i<BENCH_ITERATIONS; i++)
+	{
+		if(!w5500simAccept(0))	peerFailed = 1;
+		w5500simDeliver(0, (const unsigned char *)httpRequest, sizeof(httpRequest) - 1);
+		polls = 0;
+		do
+		{
+			TCPserver(SOC0_REG, 80);
+		}while(w5500simStatus(0) != SOCK_LISTEN && ++polls < BENCH_MAX_POLLS);
+		if(polls == BENCH_MAX_POLLS)	peerFailed = 1;
+	}
+	benchReport("HTTP GET / request", BENCH_ITERATIONS, &before);
+}
+
+#if ETHERNET_STATS
+static void benchStats(void)
+{
+	static const char statsRequest[] = "GET /stats HTTP/1.1\r\nHost: 192.168.1.4\r\n\r\n";
+	W5500simCounters before;
+	unsigned long polls = 0;
+
+	while(w5500simStatus(BENCH_CAPTURE_SOCKET) != SOCK_LISTEN && ++polls < BENCH_MAX_POLLS)	TCPserver(SOC3_REG, 80);
+	peerCaptureLength[BENCH_CAPTURE_SOCKET] = 0;
+	if(!w5500simAccept(BENCH_CAPTURE_SOCKET))	peerFailed = 1;
+	w5500simGetCounters(&before);
+	w5500simDeliver(BENCH_CAPTURE_SOCKET, (const unsigned char *)statsRequest, sizeof(statsRequest) - 1);
+	polls = 0;
+	do
+	{
+		TCPserver(SOC3_REG, 80);
+	}while(w5500simStatus(BENCH_CAPTURE_SOCKET) != SOCK_LISTEN && ++polls < BENCH_MAX_POLLS);
+	benchReport("HTTP GET /stats", 1, &before);
+
+	peerCapture[BENCH_CAPTURE_SOCKET][peerCaptureLength[BENCH_CAPTURE_SOCKET] < sizeof(peerCapture[0]) ? peerCaptureLength[BENCH_CAPTURE_SOCKET] : sizeof(peerCapture[0]) - 1] = '\0';
+	if(polls == BENCH_MAX_POLLS || strncmp((char *)peerCapture[BENCH_CAPTURE_SOCKET], "HTTP/1.0 200 OK", 15) != 0 || !strstr((char *)peerCapture[BENCH_CAPTURE_SOCKET], "\"total\":{"))	peerFailed = 1;
+}
+#endif
+
+static void benchClientTransaction(void)
+{
+	IPaddressAndPort server = {192, 168, 1, 1, 8080};
+	W5500simCounters before;
+	unsigned long i;
+
+	w5500simGetCounters(&before);
+	for(i=0; i<BENCH_ITERATIONS; i++)
+	{
+		TCPclient(SOC1_REG, 50000, server, 2);
+		if(w5500simStatus(1) != SOCK_CLOSED)	peerFailed = 1;
+	}
+	benchReport("TCPclient transaction", BENCH_ITERATIONS, &before);
+}
+
+//the first answer chains a second POST on the kept-alive connection, the second one ends the transaction
+static unsigned char benchClientResponse(unsigned long *command, const httpResponse *response)
+{
+	static unsigned char chained;
+
+	chained ^= 1;
+	if(!chained)
+	{
+		if(strcmp(response->body, "{\"time\":\"2018-05-01 12:00\"}") != 0)	peerFailed = 1;//chunked
+		return CONNECTION_CLOSE;
+	}
+	if(strcmp(response->body, "{\"status\":\"ok\"}") != 0)	peerFailed = 1;//Content-Length, in two parts
+	*command = 0;
+	return CONNECTION_KEEP_ALIVE;
+}
+
+static void benchClientPost(void)
+{
+	IPaddressAndPort server = {192, 168, 1, 1, 28080};
+	W5500simCounters before;
+	unsigned long i;
+
+	ethernetSetResponseHook(benchClientResponse);
+	w5500simGetCounters(&before);
+	for(i=0; i<BENCH_ITERATIONS; i++)
+	{
+		TCPclient(SOC1_REG, 50000, server, 0);
+		if(w5500simStatus(1) != SOCK_CLOSED || peerPosts[1] != 2)	peerFailed = 1;
+	}
+	benchReport("TCPclient 2 POSTs keep-alive", BENCH_ITERATIONS, &before);
+	ethernetSetResponseHook(NULL);
+}
+
+//masked client frame
+static unsigned int benchWebsocketFrame(unsigned char opcode, const char *payload, unsigned char length, unsigned char frame[])
+{
+	static const unsigned char mask[4] = {0x37, 0xFA, 0x21, 0x3D};
+	unsigned char i;
+
+	frame[0] = 0x80 | opcode;
+	frame[1] = 0x80 | length;
+	memcpy(frame + 2, mask, 4);
+	for(i=0; i<length; i++)	frame[6+i] = payload[i] ^ mask[i & 3];
+	return 6 + length;
+}
+
+//deliver a client frame, poll until the expected server frame was sent
+static void benchWebsocketExchange(unsigned char opcode, const char *payload, unsigned char length, const char *expect, unsigned int expectLength)
+{
+	unsigned char frame[64];
+	unsigned long polls = 0;
+
+	peerCaptureLength[BENCH_WS_SOCKET] = 0;
+	w5500simDeliver(BENCH_WS_SOCKET, frame, benchWebsocketFrame(opcode, payload, length, frame));
+	while(peerCaptureLength[BENCH_WS_SOCKET] < expectLength && ++polls < BENCH_MAX_POLLS)	TCPserver(SOC3_REG, 80);
+	if(peerCaptureLength[BENCH_WS_SOCKET] != expectLength || memcmp(peerCapture[BENCH_WS_SOCKET], expect, expectLength) != 0)	peerFailed = 1;
+}
+
+static void benchWebsocket(void)
+{
+	W5500simCounters before;
+	unsigned long i, polls = 0;
+
+	TCPserver(SOC3_REG, 80);
+	peerCaptureLength[BENCH_WS_SOCKET] = 0;
+	if(!w5500simAccept(BENCH_WS_SOCKET))	peerFailed = 1;
+	w5500simDeliver(BENCH_WS_SOCKET, (const unsigned char *)websocketRequest, sizeof(websocketRequest) - 1);
+	while(!websocketIsOpen(SOC3_REG) && ++polls < BENCH_MAX_POLLS)	TCPserver(SOC3_REG, 80);
+	peerCapture[BENCH_WS_SOCKET][peerCaptureLength[BENCH_WS_SOCKET] < sizeof(peerCapture[0]) ? peerCaptureLength[BENCH_WS_SOCKET] : sizeof(peerCapture[0]) - 1] = '\0';
+	if(!strstr((char *)peerCapture[BENCH_WS_SOCKET], "101 Switching Protocols") || !strstr((char *)peerCapture[BENCH_WS_SOCKET], websocketAcceptHeader))	peerFailed = 1;
+	if(w5500simKeepAlive(BENCH_WS_SOCKET) != WEBSOCKET_KEEP_ALIVE)	peerFailed = 1;//upgraded connection is not timed out by TCPserver, the W5500 probes it
+
+	w5500simGetCounters(&before);
+	for(i=0; i<BENCH_ITERATIONS; i++)
+	{
+		if(websocketSendText(SOC3_REG, "{\"t\":21.54}") == FAIL)	peerFailed = 1;
+	}
+	benchReport("WebSocket push 11 B", BENCH_ITERATIONS, &before);
+
+	benchWebsocketExchange(WEBSOCKET_PING, "ping", 4, "\x8A\x04ping", 6);
+	benchWebsocketExchange(WEBSOCKET_TEXT, "HELLO", 5, "\x81\x0CHELLO 2 YOU!", 14);
+	benchWebsocketExchange(WEBSOCKET_CLOSE, "\x03\xE8", 2, "\x88\x02\x03\xE8", 4);
+	if(websocketIsOpen(SOC3_REG))	peerFailed = 1;
+
+	//unsupported version gets 426 with the version we speak and is closed
+	polls = 0;
+	while(w5500simStatus(BENCH_WS_SOCKET) != SOCK_LISTEN && ++polls < BENCH_MAX_POLLS)	TCPserver(SOC3_REG, 80);
+	peerCaptureLength[BENCH_WS_SOCKET] = 0;
+	if(!w5500simAccept(BENCH_WS_SOCKET))	peerFailed = 1;
+	w5500simDeliver(BENCH_WS_SOCKET, (const unsigned char *)websocketRequestOld, sizeof(websocketRequestOld) - 1);
+	polls = 0;
+	do
+	{
+		TCPserver(SOC3_REG, 80);
+	}while(w5500simStatus(BENCH_WS_SOCKET) != SOCK_LISTEN && ++polls < BENCH_MAX_POLLS);
+	peerCapture[BENCH_WS_SOCKET][peerCaptureLength[BENCH_WS_SOCKET] < sizeof(peerCapture[0]) ? peerCaptureLength[BENCH_WS_SOCKET] : sizeof(peerCapture[0]) - 1] = '\0';
+	if(polls == BENCH_MAX_POLLS || websocketIsOpen(SOC3_REG) || strncmp((char *)peerCapture[BENCH_WS_SOCKET], "HTTP/1.1 426 ", 13) != 0 || !strstr((char *)peerCapture[BENCH_WS_SOCKET], "Sec-WebSocket-Version: 13\r\n"))	peerFailed = 1;
+}
+
+//two masters: A pipelines read 10 holding registers + write single register, B reads 16 coils
+static const unsigned char modbusRequestA[] = {0x00,0x01, 0x00,0x00, 0x00,0x06, 0x01, 0x03, 0x00,0x00, 0x00,0x0A,
+												0x00,0x02, 0x00,0x00, 0x00,0x06, 0x01, 0x06, 0x00,0x05, 0x12,0x34};
+static const unsigned char modbusRequestB[] = {0x00,0x07, 0x00,0x00, 0x00,0x06, 0x11, 0x01, 0x00,0x00, 0x00,0x10};
+static const unsigned char modbusResponseB[] = {0x00,0x07, 0x00,0x00, 0x00,0x05, 0x11, 0x01, 0x02, 0x05, 0x80};
+static const unsigned char modbusErrors[] = {0x00,0x03, 0x00,0x00, 0x00,0x06, 0x01, 0x03, 0x00,0x3C, 0x00,0x0A,//past the table
+											0x00,0x04, 0x00,0x00, 0x00,0x02, 0x01, 0x07};//unsupported function
+static const unsigned char modbusErrorsResponse[] = {0x00,0x03, 0x00,0x00, 0x00,0x03, 0x01, 0x83, 0x02,
+													0x00,0x04, 0x00,0x00, 0x00,0x03, 0x01, 0x87, 0x01};
+static const unsigned char modbusBroken[] = {0x00,0x05, 0x00,0x00, 0x00,0x06, 0x01, 0x06, 0x00,0x06, 0x43,0x21,//answered before the connection is closed
+											0x00,0x06, 0x00,0x00, 0x00,0x00, 0x01, 0x03};//MBAP length too short, framing lost
+static unsigned int modbusWrites;
+
+static void benchModbusWrite(unsigned char function, unsigned int address, unsigned int quantity)
+{
+	modbusWrites += quantity;
+}
+
+static void benchModbusPoll(unsigned char socketNumber, unsigned int expectLength)
+{
+	unsigned long polls = 0;
+
+	while(peerCaptureLength[socketNumber] < expectLength && ++polls < BENCH_MAX_POLLS)
+	{
+		modbusServer(SOC4_REG);
+		modbusServer(SOC5_REG);
+	}
+	if(peerCaptureLength[socketNumber] != expectLength)	peerFailed = 1;
+}
+
+static void benchModbus(void)
+{
+	W5500simCounters before;
+	unsigned long i, polls;
+	unsigned char j;
+
+	for(j=0; j<MODBUS_HOLDING_REGISTERS; j++)	modbusHoldingRegisters[j] = j * 10;
+	modbusCoils[0] = 0x05;
+	modbusCoils[1] = 0x80;
+	modbusSetWriteHook(benchModbusWrite);
+	modbusServer(SOC4_REG);
+	modbusServer(SOC5_REG);
+	if(!w5500simAccept(4) || !w5500simAccept(5))	peerFailed = 1;
+	if(w5500simKeepAlive(4) != MODBUS_KEEP_ALIVE || w5500simKeepAlive(5) != MODBUS_KEEP_ALIVE)	peerFailed = 1;
+
+	w5500simGetCounters(&before);
+	for(i=0; i<BENCH_ITERATIONS; i++)
+	{
+		peerCaptureLength[4] = peerCaptureLength[5] = 0;
+		w5500simDeliver(4, modbusRequestA, sizeof(modbusRequestA));
+		w5500simDeliver(5, modbusRequestB, sizeof(modbusRequestB));
+		benchModbusPoll(4, 29 + 12);//both responses of master A in one SEND
+		benchModbusPoll(5, sizeof(modbusResponseB));
+	}
+	benchReport("Modbus 3 requests, 2 masters", BENCH_ITERATIONS, &before);
+
+	if(peerCapture[4][8] != 20 || peerCapture[4][9 + 2*7] != 0 || peerCapture[4][10 + 2*7] != 70)	peerFailed = 1;//register 7 = 70
+	if(peerCapture[4][29 + 1] != 0x02 || peerCapture[4][29 + 7] != 0x06 || modbusHoldingRegisters[5] != 0x1234)	peerFailed = 1;
+	if(memcmp(peerCapture[5], modbusResponseB, sizeof(modbusResponseB)) != 0 || modbusWrites != BENCH_ITERATIONS)	peerFailed = 1;
+
+	peerCaptureLength[4] = 0;
+	w5500simDeliver(4, modbusErrors, sizeof(modbusErrors));
+	benchModbusPoll(4, sizeof(modbusErrorsResponse));
+	if(memcmp(peerCapture[4], modbusErrorsResponse, sizeof(modbusErrorsResponse)) != 0)	peerFailed = 1;
+
+	//write in front of lost framing is executed and answered, then the connection is closed
+	peerCaptureLength[4] = 0;
+	w5500simDeliver(4, modbusBroken, sizeof(modbusBroken));
+	benchModbusPoll(4, 12);
+	if(memcmp(peerCapture[4], modbusBroken, 12) != 0 || modbusHoldingRegisters[6] != 0x4321)	peerFailed = 1;
+	polls = 0;
+	while(w5500simStatus(4) != SOCK_LISTEN && ++polls < BENCH_MAX_POLLS)	modbusServer(SOC4_REG);
+	if(polls == BENCH_MAX_POLLS)	peerFailed = 1;
+}
+
+static unsigned int controlLateMax;
+
+//10 ms control loop competing with the network task
+static unsigned char benchControlTask(task *t)
+{
+	static unsigned int due;
+
+	TASK_BEGIN(t);
+	while(1)
+	{
+		due = schedulerTicks() + 10;
+		TASK_SLEEP(t, 10);
+		if(TICKS_ELAPSED(due) > controlLateMax)	controlLateMax = TICKS_ELAPSED(due);
+	}
+	TASK_END(t);
+}
+
+static unsigned long idleCalls;
+
+static void benchIdle(void)
+{
+	idleCalls++;
+	_delay_us(100);//sleep until next interrupt
+}
+
+static void benchSchedulerHTTP(void)
+{
+	TCPserverTaskData server = {SOC2_REG, 80, 0};
+	task serverTask, controlTask;
+	unsigned char longRequest[1500];
+	W5500simCounters before;
+	unsigned long i, polls;
+
+	schedulerInit();
+	schedulerSetIdleHook(benchIdle);
+	schedulerAdd(&serverTask, TCPserverTask, &server);
+	schedulerAdd(&controlTask, benchControlTask, NULL);
+	while(w5500simStatus(2) != SOCK_LISTEN)	schedulerRunOnce();
+
+	w5500simGetCounters(&before);
+	for(i=0; i<BENCH_ITERATIONS; i++)
+	{
+		if(!w5500simAccept(2))	peerFailed = 1;
+		w5500simDeliver(2, (const unsigned char *)httpRequest, sizeof(httpRequest) - 1);
+		polls = 0;
+		do
+		{
+			schedulerRunOnce();
+		}while(w5500simStatus(2) != SOCK_LISTEN && ++polls < BENCH_MAX_POLLS);
+		if(polls == BENCH_MAX_POLLS)	peerFailed = 1;
+	}
+	benchReport("HTTP GET / on scheduler", BENCH_ITERATIONS, &before);
+	printf("%-28s %6s max lateness of 10 ms control task: %u ms\n", "", "", controlLateMax);
+	if(controlLateMax >= BENCH_MAX_LATENESS)	peerFailed = 1;
+
+	//1500 B segment, more than RX_BUFFER_SIZE: first part is processed, the rest stays in the W5500
+	memset(longRequest, 'x', sizeof(longRequest));
+	memcpy(longRequest, httpRequest, sizeof(httpRequest) - 1);
+	if(!w5500simAccept(2))	peerFailed = 1;
+	w5500simDeliver(2, longRequest, sizeof(longRequest));
+	polls = 0;
+	do
+	{
+		schedulerRunOnce();
+	}while(w5500simStatus(2) != SOCK_LISTEN && ++polls < BENCH_MAX_POLLS);
+	if(polls == BENCH_MAX_POLLS)	peerFailed = 1;
+}
+
+static void benchRunFor(unsigned int ms)
+{
+	unsigned int start = schedulerTicks();
+
+	while(TICKS_ELAPSED(start) < ms)	schedulerRunOnce();
+}
+
+static unsigned long mqttCommands;
+
+static void benchMQTTreceived(const char topic[], unsigned int topicLength, const char payload[], unsigned int length)
+{
+	if(topicLength != 7 || memcmp(topic, "cmd/led", 7) != 0 || length != 2 || memcmp(payload, "on", 2) != 0)	peerFailed = 1;
+	mqttCommands++;
+}
+
+//10 publishes (5 x QoS 0, 5 x QoS 1) queued at once must leave in one SEND and be acknowledged
+static void benchMQTT(void)
+{
+	static mqttClient client;
+	IPaddressAndPort broker = {192, 168, 1, 10, MQTT_PORT};
+	task mqttTask;
+	W5500simCounters before;
+	unsigned long i, polls, sends, idle, commands, pubacks, publishes;
+	unsigned char j;
+	char payload[8];
+	unsigned char bigPublish[3 + 11 + 200];
+
+	schedulerInit();
+	schedulerSetIdleHook(benchIdle);
+	mqttInit(&client, SOC6_REG, 50001, broker, "bench", 2, benchMQTTreceived);
+	mqttSubscribe(&client, "cmd/led", 1);
+	schedulerAdd(&mqttTask, mqttClientTask, &client);
+	polls = 0;
+	while((!mqttIsConnected(&client) || brokerPubacks == 0) && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();
+	if(mqttCommands != 1 || brokerSubscribed != 1)	peerFailed = 1;
+
+	w5500simGetCounters(&before);
+	sends = brokerSends;
+	for(i=0; i<BENCH_ITERATIONS; i++)
+	{
+		for(j=0; j<10; j++)
+		{
+			sprintf(payload, "%u.%u", (unsigned int)(i % 100), j);
+			if(mqttPublish(&client, (j & 1) ? "sensor/t" : "sensor/h", payload, strlen(payload), j & 1, 0) == FAIL)	peerFailed = 1;
+		}
+		polls = 0;
+		while((client.queueLength || client.inflightLength) && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();
+		if(polls == BENCH_MAX_POLLS)	peerFailed = 1;
+	}
+	benchReport("MQTT 10 publishes", BENCH_ITERATIONS, &before);
+	if(brokerPublishes != 10 * BENCH_ITERATIONS)	peerFailed = 1;
+	printf("%-28s %6s broker SENDs per batch: %.2f\n", "", "", (double)(brokerSends - sends) / BENCH_ITERATIONS);
+
+	polls = 0;
+	while(brokerPings == 0 && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();//idle connection, keep alive 2 s
+	while(client.pingOutstanding && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();
+	if(brokerPings == 0 || !mqttIsConnected(&client))	peerFailed = 1;
+
+	//start of a packet alone: nothing is consumed, the task lets the idle hook run
+	commands = mqttCommands;
+	pubacks = brokerPubacks;
+	w5500simDeliver(BENCH_MQTT_SOCKET, brokerCommand, 3);
+	idle = idleCalls;
+	for(polls=0; polls<100; polls++)	schedulerRunOnce();
+	if(idleCalls - idle < 50)	peerFailed = 1;
+	w5500simDeliver(BENCH_MQTT_SOCKET, brokerCommand + 3, sizeof(brokerCommand) - 3);
+	polls = 0;
+	while(brokerPubacks == pubacks && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();
+	if(mqttCommands != commands + 1)	peerFailed = 1;
+
+	//QoS 1 publish bigger than MQTT_RX_SIZE: payload dropped, PUBACK sent anyway
+	memset(bigPublish, 'x', sizeof(bigPublish));
+	memcpy(bigPublish, brokerCommand, 13);
+	bigPublish[1] = 0x80 | ((sizeof(bigPublish) - 3) & 0x7F);
+	bigPublish[2] = (sizeof(bigPublish) - 3) >> 7;
+	memcpy(bigPublish + 3, brokerCommand + 2, 11);//topic and packet id
+	pubacks = brokerPubacks;
+	w5500simDeliver(BENCH_MQTT_SOCKET, bigPublish, sizeof(bigPublish));
+	polls = 0;
+	while(brokerPubacks == pubacks && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();
+	if(polls == BENCH_MAX_POLLS || mqttCommands != commands + 1 || !mqttIsConnected(&client))	peerFailed = 1;
+
+	//connection lost with packets queued: the QoS 0 publish is dropped with the queue, the QoS 1 one goes out once from inflight
+	publishes = brokerPublishes;
+	mqttPublish(&client, "sensor/t", "1", 1, 0, 0);
+	mqttPublish(&client, "sensor/h", "2", 1, 1, 0);
+	w5500simRemoteReset(BENCH_MQTT_SOCKET);
+	benchRunFor(MQTT_RECONNECT_DELAY + 500);//the stand-in accepts at once, reconnect and CONNACK happen within one pass
+	polls = 0;
+	while((!mqttIsConnected(&client) || client.inflightLength) && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();
+	if(polls == BENCH_MAX_POLLS || brokerPublishes != publishes + 1 || client.queueLength || client.pingOutstanding)	peerFailed = 1;
+}
+
+static void benchRunTask(task *t)//until it exits
+{
+	unsigned long polls = 0;
+
+	do
+	{
+		schedulerRunOnce();
+	}while(t->lc != 0 && ++polls < BENCH_MAX_POLLS);
+	if(polls == BENCH_MAX_POLLS)	peerFailed = 1;
+}
+
+//TCPclientTask connecting by name, the name costs one query per TTL
+static void benchDNS(void)
+{
+	address server = {GW0, GW1, GW2, GW3};
+	TCPclientTaskData client = {SOC1_REG, 50000, {0, 0, 0, 0, 8080}, CLIENT_SERVER_NAME, 2};
+	task resolverTask, clientTask;
+	W5500simCounters before;
+	unsigned long i, polls, queries;
+	unsigned int port;
+	address ip;
+
+	schedulerInit();
+	schedulerSetIdleHook(benchIdle);
+	dnsInit(SOC7_REG, server);
+	schedulerAdd(&resolverTask, dnsTask, NULL);
+
+	schedulerAdd(&clientTask, TCPclientTask, &client);
+	benchRunTask(&clientTask);
+	if(dnsQueries != 1 || memcmp(peerConnectIP, "\xC0\xA8\x01\x14", 4) != 0 || client.server.socketPort != 8080)	peerFailed = 1;
+
+	w5500simGetCounters(&before);
+	queries = dnsQueries;
+	for(i=0; i<BENCH_ITERATIONS; i++)
+	{
+		peerConnectIP[0] = 0;
+		schedulerAdd(&clientTask, TCPclientTask, &client);
+		benchRunTask(&clientTask);
+		if(peerConnectIP[0] != 192)	peerFailed = 1;
+	}
+	benchReport("TCPclient by name, cached", BENCH_ITERATIONS, &before);
+	printf("%-28s %6s DNS queries: first connect 1, cached %lu", "", "", dnsQueries - queries);
+
+	_delay_ms(31000);//TTL 30 s
+	queries = dnsQueries;
+	schedulerAdd(&clientTask, TCPclientTask, &client);
+	benchRunTask(&clientTask);
+	printf(", after TTL %lu", dnsQueries - queries);
+	if(dnsQueries - queries != 1 || peerConnectIP[0] != 192)	peerFailed = 1;
+
+	queries = dnsQueries;
+	for(i=0; i<BENCH_ITERATIONS; i++)
+	{
+		polls = 0;
+		while(dnsResolve("nosuch.example", &ip) == DNS_PENDING && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();
+		if(dnsResolve("nosuch.example", &ip) != DNS_FAILED)	peerFailed = 1;
+	}
+	printf(", NXDOMAIN %lu\n", dnsQueries - queries);
+	if(dnsQueries - queries != 1)	peerFailed = 1;
+
+	//fully qualified name is the same question, malformed names fail without a query
+	queries = dnsQueries;
+	polls = 0;
+	while(dnsResolve(CLIENT_SERVER_NAME ".", &ip) == DNS_PENDING && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();
+	if(dnsResolve(CLIENT_SERVER_NAME ".", &ip) != DNS_RESOLVED || ip.b3 != 20)	peerFailed = 1;
+	if(dnsResolve("server0..tipa.eu", &ip) != DNS_FAILED || dnsResolve(".", &ip) != DNS_FAILED || dnsResolve("tipa.eu..", &ip) != DNS_FAILED || dnsQueries - queries != 1)	peerFailed = 1;
+
+	//slow server: the answer to the first attempt arrives after the retry, a new lookup uses a new source port
+	dnsFlush();
+	dnsSlow = 1;
+	queries = dnsQueries;
+	port = dnsQueryPort;
+	polls = 0;
+	while(dnsResolve(CLIENT_SERVER_NAME, &ip) == DNS_PENDING && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();
+	if(dnsResolve(CLIENT_SERVER_NAME, &ip) != DNS_RESOLVED || ip.b3 != 20 || dnsQueries - queries != 2 || dnsQueryPort == port)	peerFailed = 1;
+}
+
+//power-on with DHCP, returns DHCP messages sent until the address is bound
+static unsigned long benchDHCPboot(const char *name)
+{
+	MACaddress mac = {MAC0, MAC1, MAC2, MAC3, MAC4, MAC5};
+	address zero = {0, 0, 0, 0};
+	static task dhcpTaskData;
+	W5500simCounters before;
+	unsigned long polls = 0, messages = dhcpMessages;
+
+	w5500simReset();//EEPROM keeps its content
+	ethernetInit(zero, zero, zero, mac);
+	schedulerInit();
+	schedulerSetIdleHook(benchIdle);
+	w5500simGetCounters(&before);
+	dhcpInit(SOC5_REG, mac);
+	schedulerAdd(&dhcpTaskData, dhcpTask, NULL);
+	while(dhcpState() != DHCP_BOUND && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();
+	benchReport(name, 1, &before);
+	if(ethernetRXdata8(SIPR+3, 0) != dhcpPool || w5500simStatus(5) != SOCK_CLOSED)	peerFailed = 1;
+
+	return dhcpMessages - messages;
+}
+
+static void benchDHCP(void)
+{
+	unsigned long first, reboot, renewal, wrong, refused, polls = 0;
+	dhcpLease lease;
+
+	first = benchDHCPboot("DHCP first boot");
+	reboot = benchDHCPboot("DHCP reboot, lease in EEPROM");
+
+	renewal = dhcpMessages;
+	dhcpShortDNS = 1;
+	_delay_ms(61000);//T1 of 120 s lease
+	schedulerRunOnce();
+	while(dhcpState() != DHCP_BOUND && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();
+	renewal = dhcpMessages - renewal;
+	if(dhcpGetLease(&lease) == FAIL || lease.leaseTime != 120 || lease.gateway.b3 != 1 || lease.dns.b0 != 192 || ethernetRXdata8(SIPR+3, 0) != dhcpPool)	peerFailed = 1;
+
+	//ACK for an address we did not ask for is ignored, the lease stays as it was until the retransmission is acknowledged
+	wrong = dhcpMessages;
+	dhcpWrongAck = 1;
+	_delay_ms(61000);
+	polls = 0;
+	schedulerRunOnce();
+	while(dhcpState() != DHCP_BOUND && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();
+	wrong = dhcpMessages - wrong;
+	if(dhcpGetLease(&lease) == FAIL || lease.gateway.b3 != 1 || lease.ip.b3 != dhcpPool || ethernetRXdata8(SIPR+3, 0) != dhcpPool)	peerFailed = 1;
+
+	dhcpPool = 60;//server does not know the stored address any more
+	refused = benchDHCPboot("DHCP reboot, address refused");
+	printf("%-28s %6s DHCP messages: first boot %lu, reboot %lu, renewal %lu, wrong ACK %lu, refused %lu\n", "", "", first, reboot, renewal, wrong, refused);
+	if(first != 2 || reboot != 1 || renewal != 1 || wrong != 2 || refused != 3)	peerFailed = 1;
+}
+
+static unsigned char linkEvents[3];//count per LINK_* event
+
+static void benchLinkHook(unsigned char event, unsigned char phy)
+{
+	linkEvents[event]++;
+	if(event == LINK_UP && (phy & (PHYCFGR_SPD | PHYCFGR_DPX)) != (PHYCFGR_SPD | PHYCFGR_DPX))	peerFailed = 1;
+}
+
+//established connection survives a 2 s cable drop in the W5500, the monitor closes it on link up and the server listens again
+static void benchLink(void)
+{
+	address IPaddress = {IP0, IP1, IP2, IP3};
+	address mask = {MASK0, MASK1, MASK2, MASK3};
+	address gateway = {GW0, GW1, GW2, GW3};
+	MACaddress mac = {MAC0, MAC1, MAC2, MAC3, MAC4, MAC5};
+	TCPserverTaskData server = {SOC2_REG, 80, 0};
+	task serverTask, linkTask;
+	W5500simCounters before;
+	unsigned long long linkUpNs;
+	unsigned long polls = 0;
+
+	w5500simGetCounters(&before);
+	if(ethernetHardwareReset() == FAIL)	peerFailed = 1;
+	benchReport("ethernetHardwareReset", 1, &before);
+	ethernetInit(IPaddress, mask, gateway, mac);
+
+	ethernetSetPHYmode(PHY_MODE_10_HALF);
+	if((ethernetGetPHYstatus() & (PHYCFGR_LNK | PHYCFGR_SPD | PHYCFGR_DPX)) != PHYCFGR_LNK)	peerFailed = 1;
+	ethernetSetPHYmode(PHY_MODE_100_FULL);
+	if((ethernetGetPHYstatus() & (PHYCFGR_LNK | PHYCFGR_SPD | PHYCFGR_DPX)) != (PHYCFGR_LNK | PHYCFGR_SPD | PHYCFGR_DPX))	peerFailed = 1;
+	ethernetSetPHYmode(PHY_MODE_AUTO);
+
+	schedulerInit();
+	schedulerSetIdleHook(benchIdle);
+	ethernetSetLinkHook(benchLinkHook);
+	schedulerAdd(&serverTask, TCPserverTask, &server);
+	while(w5500simStatus(2) != SOCK_LISTEN && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();
+	if(!w5500simAccept(2))	peerFailed = 1;
+	schedulerAdd(&linkTask, ethernetLinkTask, NULL);//first poll sees the link up, the connection stays
+	benchRunFor(50);
+	if(w5500simStatus(2) != SOCK_ESTABLISHED || linkEvents[LINK_UP] != 0)	peerFailed = 1;
+
+	w5500simSetLink(0);
+	benchRunFor(2000);
+	if(w5500simStatus(2) != SOCK_ESTABLISHED || linkEvents[LINK_DOWN] != 1)	peerFailed = 1;
+
+	w5500simSetLink(1);
+	linkUpNs = w5500simNowNs();
+	polls = 0;
+	while(w5500simStatus(2) != SOCK_LISTEN && ++polls < BENCH_MAX_POLLS)	schedulerRunOnce();
+	printf("%-28s %6s link up -> LISTEN again: %.1f ms (server timeout %u ms)\n", "", "", (w5500simNowNs() - linkUpNs) / 1e6, WAIT_FOR_DATA_RECEIVE);
+	if(polls == BENCH_MAX_POLLS || linkEvents[LINK_UP] != 1)	peerFailed = 1;//recovery only, the link was up at start
+	ethernetSetLinkHook(NULL);
+}
+
+static unsigned int benchFrameCRC(const unsigned char data[], unsigned int length)//CRC-16/CCITT-FALSE
+{
+	unsigned int crc = 0xFFFF, i, bit;
+
+	for(i=0; i<length; i++)
+	{
+		crc ^= (unsigned int)data[i] << 8;
+		for(bit=0; bit<8; bit++)	crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) & 0xFFFF : (crc << 1) & 0xFFFF;
+	}
+	return crc;
+}
+
+static unsigned int benchFrame(unsigned char opcode, unsigned int sequence, const char *payload, unsigned int length, unsigned char frame[])
+{
+	unsigned int crc;
+
+	frame[0] = FRAME_SYNC;
+	frame[1] = length >> 8;
+	frame[2] = length & 0xFF;
+	frame[3] = opcode;
+	frame[4] = sequence >> 8;
+	frame[5] = sequence & 0xFF;
+	memcpy(frame + FRAME_HEADER_SIZE, payload, length);
+	crc = benchFrameCRC(frame + 1, FRAME_HEADER_SIZE - 1 + length);
+	frame[FRAME_HEADER_SIZE + length] = crc >> 8;
+	frame[FRAME_HEADER_SIZE + length + 1] = crc & 0xFF;
+	return FRAME_HEADER_SIZE + length + FRAME_CRC_SIZE;
+}
+
+//checks the response frame at *offset of the capture and moves past it
+static void benchFrameResponse(unsigned int *offset, unsigned char opcode, unsigned int sequence, unsigned char status, const char *data, unsigned int length)
+{
+	const unsigned char *frame = peerCapture[BENCH_FRAME_SOCKET] + *offset;
+	unsigned int crc = benchFrameCRC(frame + 1, FRAME_HEADER_SIZE + length);
+
+	if(*offset + FRAME_HEADER_SIZE + 1 + length + FRAME_CRC_SIZE > peerCaptureLength[BENCH_FRAME_SOCKET])	peerFailed = 1;
+	else if(frame[0] != FRAME_SYNC || frame[1] != 0 || frame[2] != length + 1 || frame[3] != (opcode | FRAME_RESPONSE) || frame[4] != (sequence >> 8) || frame[5] != (sequence & 0xFF))	peerFailed = 1;
+	else if(frame[6] != status || memcmp(frame + FRAME_HEADER_SIZE + 1, data, length) != 0)	peerFailed = 1;
+	else if(frame[FRAME_HEADER_SIZE + 1 + length] != (crc >> 8) || frame[FRAME_HEADER_SIZE + 2 + length] != (crc & 0xFF))	peerFailed = 1;
+	*offset += FRAME_HEADER_SIZE + 1 + length + FRAME_CRC_SIZE;
+}
+
+static void benchFrames(void)
+{
+	TCPserverTaskData server = {SOC3_REG, 80, 0};
+	task serverTask;
+	W5500simCounters before, after;
+	unsigned char request[BENCH_FRAMES * (FRAME_HEADER_SIZE + 8 + FRAME_CRC_SIZE)];
+	unsigned int length, offset, sequence = 0, start;
+	unsigned long i, j, polls = 0, expect;
+
+	while(w5500simStatus(BENCH_FRAME_SOCKET) != SOCK_LISTEN && ++polls < BENCH_MAX_POLLS)	TCPserver(SOC3_REG, 80);
+	if(!w5500simAccept(BENCH_FRAME_SOCKET))	peerFailed = 1;
+
+	expect = BENCH_FRAMES * (FRAME_HEADER_SIZE + 1 + 8 + FRAME_CRC_SIZE);
+	w5500simGetCounters(&before);
+	for(i=0; i<BENCH_ITERATIONS; i++)
+	{
+		for(j=0, length=0; j<BENCH_FRAMES; j++)	length += benchFrame(FRAME_PING, sequence + j, "21.54 ", 8, request + length);
+		peerCaptureLength[BENCH_FRAME_SOCKET] = 0;
+		w5500simDeliver(BENCH_FRAME_SOCKET, request, length);
+		polls = 0;
+		while(peerCaptureLength[BENCH_FRAME_SOCKET] < expect && ++polls < BENCH_MAX_POLLS)	TCPserver(SOC3_REG, 80);
+		for(j=0, offset=0; j<BENCH_FRAMES; j++)	benchFrameResponse(&offset, FRAME_PING, sequence + j, FRAME_OK, "21.54 ", 8);
+		sequence += BENCH_FRAMES;
+	}
+	benchReport("10 pipelined frames", BENCH_ITERATIONS, &before);
+	w5500simGetCounters(&after);
+	if(after.sendCommands - before.sendCommands != BENCH_ITERATIONS || w5500simStatus(BENCH_FRAME_SOCKET) != SOCK_ESTABLISHED)	peerFailed = 1;//one SEND per batch, one connection
+
+	//split request, unknown opcode and bad CRC are answered, the connection stays open
+	peerCaptureLength[BENCH_FRAME_SOCKET] = 0;
+	length = benchFrame(FRAME_HELLO, 1, "", 0, request);
+	length += benchFrame(0x7E, 2, "", 0, request + length);
+	length += benchFrame(FRAME_PING, 3, "x", 1, request + length);
+	request[length - 1] ^= 0x01;
+	w5500simDeliver(BENCH_FRAME_SOCKET, request, 5);
+	TCPserver(SOC3_REG, 80);
+	if(peerCaptureLength[BENCH_FRAME_SOCKET] != 0)	peerFailed = 1;
+	w5500simDeliver(BENCH_FRAME_SOCKET, request + 5, length - 5);
+	polls = 0;
+	while(peerCaptureLength[BENCH_FRAME_SOCKET] < 21 + 9 + 9 && ++polls < BENCH_MAX_POLLS)	TCPserver(SOC3_REG, 80);
+	offset = 0;
+	benchFrameResponse(&offset, FRAME_HELLO, 1, FRAME_OK, "HELLO 2 YOU!", 12);
+	benchFrameResponse(&offset, 0x7E, 2, FRAME_UNKNOWN_OPCODE, "", 0);
+	benchFrameResponse(&offset, FRAME_PING, 3, FRAME_BAD_CRC, "", 0);
+	if(w5500simStatus(BENCH_FRAME_SOCKET) != SOCK_ESTABLISHED)	peerFailed = 1;
+
+	//lost framing closes the connection, the server listens again
+	request[0] = FRAME_SYNC;
+	request[1] = 0xFF;
+	memset(request + 2, 0, FRAME_HEADER_SIZE + FRAME_CRC_SIZE - 2);
+	w5500simDeliver(BENCH_FRAME_SOCKET, request, FRAME_HEADER_SIZE + FRAME_CRC_SIZE);
+	polls = 0;
+	while(w5500simStatus(BENCH_FRAME_SOCKET) != SOCK_LISTEN && ++polls < BENCH_MAX_POLLS)	TCPserver(SOC3_REG, 80);
+	if(polls == BENCH_MAX_POLLS)	peerFailed = 1;
+
+	//start of a frame alone is no activity, the connection times out in TCPserver and in TCPserverTask
+	request[1] = 0;
+	request[2] = 5;
+	if(!w5500simAccept(BENCH_FRAME_SOCKET))	peerFailed = 1;
+	w5500simDeliver(BENCH_FRAME_SOCKET, request, 3);
+	polls = 0;
+	while(w5500simStatus(BENCH_FRAME_SOCKET) != SOCK_LISTEN && ++polls < BENCH_MAX_POLLS)	TCPserver(SOC3_REG, 80);
+	if(polls < WAIT_FOR_DATA_RECEIVE || polls == BENCH_MAX_POLLS)	peerFailed = 1;
+
+	schedulerInit();
+	schedulerSetIdleHook(benchIdle);
+	schedulerAdd(&serverTask, TCPserverTask, &server);
+	schedulerRunOnce();
+	if(!w5500simAccept(BENCH_FRAME_SOCKET))	peerFailed = 1;
+	w5500simDeliver(BENCH_FRAME_SOCKET, request, 3);
+	start = schedulerTicks();
+	polls = 0;
+	do
+	{
+		schedulerRunOnce();
+	}while(w5500simStatus(BENCH_FRAME_SOCKET) != SOCK_LISTEN && TICKS_ELAPSED(start) < 2 * WAIT_FOR_DATA_RECEIVE && ++polls < 10 * BENCH_MAX_POLLS);
+	if(w5500simStatus(BENCH_FRAME_SOCKET) != SOCK_LISTEN || TICKS_ELAPSED(start) < WAIT_FOR_DATA_RECEIVE)	peerFailed = 1;
+}
+
+int main(int argc, char *argv[])
+{
+	w5500simReset();
+	w5500simSetPeer(&benchPeer);
+	w5500simSetUARTecho(argc > 1 && strcmp(argv[1], "-v") == 0);
+#if ETHERNET_STATS
+	ethernetStatsInit();
+#endif
+
+	printf("%-28s %6s %12s %10s %8s %12s %10s\n", "scenario", "iter", "SPI bytes", "CS cycles", "SENDs", "UART bytes", "us");
+	benchEthernetInit();
+	benchServerIdle();
+	benchHTTPrequest();
+#if ETHERNET_STATS
+	benchStats();
+#endif
+	benchClientTransaction();
+	benchClientPost();
+	benchSchedulerHTTP();
+	benchWebsocket();
+	benchModbus();
+	benchMQTT();
+	benchDNS();
+	benchDHCP();
+	benchLink();
+	benchFrames();
+
+	if(peerFailed)
+	{
+		fprintf(stderr, "benchmark scenario did not complete\n");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
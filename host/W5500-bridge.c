@@ -0,0 +1,395 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @license GNU GPL v3
+ * @brief   Bridge from the host W5500 model to Linux TCP sockets
+ * @verbatim
+	Emulated W5500 sockets backed by real localhost listeners and connections
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "W5500-sim.h"
+#include "W5500-bridge.h"
+#include "W5500.h"
+
+
+typedef struct
+{
+	int fd;
+	unsigned int listenPort;//W5500 port while in LISTEN, 0 = none
+	unsigned char connecting;
+	unsigned char eof;
+	unsigned char pending[2048];//received from Linux, not yet stored in the W5500 RX buffer
+	unsigned int pendingOffset;
+	unsigned int pendingLength;
+}BridgeSocket;
+
+typedef struct
+{
+	int fd;
+	unsigned int port;
+}BridgeListener;
+
+static BridgeSocket bridgeSockets[W5500SIM_SOCKETS];
+static BridgeListener bridgeListeners[W5500SIM_SOCKETS];
+static W5500bridgeCounters bridgeCounters;
+static unsigned int bridgePortOffset;
+static unsigned long long bridgeLastPollNs;
+static unsigned char bridgeRealTime;
+static unsigned long long bridgeStartNs;//wall clock at modeled time 0
+
+
+static void bridgeRelease(unsigned char socketNumber, unsigned char reset)
+{
+	BridgeSocket *s = &bridgeSockets[socketNumber];
+	struct linger lingerReset = {1, 0};
+
+	if(s->fd < 0)	return;
+	if(reset)	setsockopt(s->fd, SOL_SOCKET, SO_LINGER, &lingerReset, sizeof(lingerReset));
+	close(s->fd);
+	s->fd = -1;
+	s->connecting = 0;
+	s->eof = 0;
+	s->pendingOffset = 0;
+	s->pendingLength = 0;
+}
+
+static int bridgeListener(unsigned int port)
+{
+	struct sockaddr_in addr;
+	int fd, yes = 1;
+	unsigned char i;
+
+	for(i=0; i<W5500SIM_SOCKETS; i++)
+	{
+		if(bridgeListeners[i].fd >= 0 && bridgeListeners[i].port == port)	return bridgeListeners[i].fd;
+	}
+	for(i=0; i<W5500SIM_SOCKETS && bridgeListeners[i].fd >= 0; i++);
+	if(i == W5500SIM_SOCKETS)	return -1;
+
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if(fd < 0)	return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port + bridgePortOffset);
+	if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, W5500BRIDGE_BACKLOG) < 0)
+	{
+		fprintf(stderr, "bridge: cannot listen on 127.0.0.1:%u: %s\n", port + bridgePortOffset, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	bridgeListeners[i].fd = fd;
+	bridgeListeners[i].port = port;
+	return fd;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//W5500 model callbacks
+
+static void bridgeListen(unsigned char socketNumber, unsigned int port)
+{
+	bridgeRelease(socketNumber, 1);
+	if(bridgeListener(port) >= 0)	bridgeSockets[socketNumber].listenPort = port;
+}
+
+static void bridgeConnect(unsigned char socketNumber, const unsigned char ip[4], unsigned int port)
+{
+	BridgeSocket *s = &bridgeSockets[socketNumber];
+	struct sockaddr_in addr;
+	int yes = 1;
+
+	bridgeRelease(socketNumber, 1);
+	s->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if(s->fd < 0)	return;//SYNSENT until W5500 timeout, as with an unreachable host
+	setsockopt(s->fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port + bridgePortOffset);
+	if(connect(s->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS)
+	{
+		bridgeCounters.connectFailed++;
+		bridgeRelease(socketNumber, 0);
+		w5500simRemoteReset(socketNumber);
+		return;
+	}
+	s->connecting = 1;
+}
+
+static void bridgeSend(unsigned char socketNumber, const unsigned char *data, unsigned int length)
+{
+	BridgeSocket *s = &bridgeSockets[socketNumber];
+	struct pollfd writable;
+	ssize_t sent;
+
+	if(s->fd < 0)	return;
+	bridgeCounters.bytesFromDevice += length;
+
+	while(length)
+	{
+		sent = send(s->fd, data, length, MSG_NOSIGNAL);
+		if(sent > 0)
+		{
+			data += sent;
+			length -= sent;
+		}
+		else if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			writable.fd = s->fd;
+			writable.events = POLLOUT;
+			poll(&writable, 1, 100);
+		}
+		else
+		{
+			bridgeCounters.resetByRemote++;
+			bridgeRelease(socketNumber, 0);
+			w5500simRemoteReset(socketNumber);
+			return;
+		}
+	}
+}
+
+static void bridgeDisconnect(unsigned char socketNumber)
+{
+	BridgeSocket *s = &bridgeSockets[socketNumber];
+
+	if(s->fd < 0)	return;
+	bridgeCounters.finByDevice++;
+	if(w5500simStatus(socketNumber) == SOCK_CLOSED)//answer to remote FIN, nothing more to wait for
+	{
+		bridgeRelease(socketNumber, 0);
+	}
+	else
+	{
+		shutdown(s->fd, SHUT_WR);
+	}
+}
+
+static void bridgeClose(unsigned char socketNumber)
+{
+	bridgeSockets[socketNumber].listenPort = 0;
+	if(bridgeSockets[socketNumber].fd < 0)	return;
+	bridgeCounters.resetByDevice++;
+	bridgeRelease(socketNumber, 1);
+}
+
+static unsigned long long bridgeWallNs(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void bridgeAdvance(unsigned long long nowNs)
+{
+	unsigned long long wallNs;
+	struct timespec ahead;
+
+	if(nowNs - bridgeLastPollNs < W5500BRIDGE_POLL_INTERVAL_NS)	return;
+	bridgeLastPollNs = nowNs;
+
+	if(bridgeRealTime)
+	{
+		wallNs = bridgeWallNs() - bridgeStartNs;
+		if(nowNs > wallNs + W5500BRIDGE_REALTIME_SLACK_NS)//MCU is ahead, wait for the wall clock
+		{
+			ahead.tv_sec = (nowNs - wallNs) / 1000000000ULL;
+			ahead.tv_nsec = (nowNs - wallNs) % 1000000000ULL;
+			nanosleep(&ahead, NULL);
+		}
+	}
+	w5500bridgePoll();
+}
+
+static const W5500simPeer bridgePeer =
+{
+	.listen = bridgeListen,
+	.connect = bridgeConnect,
+	.send = bridgeSend,
+	.disconnect = bridgeDisconnect,
+	.close = bridgeClose,
+	.advance = bridgeAdvance,
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+static void bridgeAccept(unsigned char socketNumber)
+{
+	BridgeSocket *s = &bridgeSockets[socketNumber];
+	int listener = bridgeListener(s->listenPort);
+	int fd, yes = 1;
+
+	if(listener < 0)	return;
+	fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK);
+	if(fd < 0)	return;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+	s->fd = fd;
+	s->listenPort = 0;
+	w5500simAccept(socketNumber);
+	bridgeCounters.accepted++;
+}
+
+static void bridgeConnectDone(unsigned char socketNumber)
+{
+	BridgeSocket *s = &bridgeSockets[socketNumber];
+	struct pollfd writable = {s->fd, POLLOUT, 0};
+	int error = 0;
+	socklen_t length = sizeof(error);
+
+	if(poll(&writable, 1, 0) <= 0)	return;//still connecting
+	getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+	s->connecting = 0;
+
+	if(error)
+	{
+		bridgeCounters.connectFailed++;
+		bridgeRelease(socketNumber, 0);
+		w5500simRemoteReset(socketNumber);
+	}
+	else
+	{
+		bridgeCounters.connected++;
+		w5500simEstablish(socketNumber);
+	}
+}
+
+static void bridgeReceive(unsigned char socketNumber)
+{
+	BridgeSocket *s = &bridgeSockets[socketNumber];
+	ssize_t received;
+	unsigned int stored;
+
+	if(s->pendingLength == 0 && !s->eof)
+	{
+		received = recv(s->fd, s->pending, sizeof(s->pending), 0);
+		if(received > 0)
+		{
+			s->pendingOffset = 0;
+			s->pendingLength = received;
+		}
+		else if(received == 0)
+		{
+			s->eof = 1;
+			bridgeCounters.finByRemote++;
+			w5500simRemoteClose(socketNumber);
+		}
+		else if(errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			bridgeCounters.resetByRemote++;
+			bridgeRelease(socketNumber, 0);
+			w5500simRemoteReset(socketNumber);
+			return;
+		}
+	}
+
+	if(s->pendingLength)
+	{
+		stored = w5500simDeliver(socketNumber, s->pending + s->pendingOffset, s->pendingLength);//RX buffer may be full
+		s->pendingOffset += stored;
+		s->pendingLength -= stored;
+		bridgeCounters.bytesToDevice += stored;
+	}
+}
+
+void w5500bridgePoll(void)
+{
+	unsigned char i, status;
+
+	for(i=0; i<W5500SIM_SOCKETS; i++)
+	{
+		BridgeSocket *s = &bridgeSockets[i];
+		status = w5500simStatus(i);
+
+		if(status == SOCK_LISTEN && s->listenPort)
+		{
+			bridgeAccept(i);
+		}
+		else if(s->fd >= 0 && s->connecting)
+		{
+			bridgeConnectDone(i);
+		}
+		else if(s->fd >= 0 && (status == SOCK_ESTABLISHED || status == SOCK_FIN_WAIT))
+		{
+			bridgeReceive(i);
+		}
+
+		if(s->fd >= 0 && w5500simStatus(i) == SOCK_CLOSED)//closed by FIN exchange or W5500 timeout
+		{
+			bridgeRelease(i, 0);
+		}
+	}
+}
+
+unsigned char w5500bridgeInit(unsigned int portOffset, unsigned char realTime)
+{
+	unsigned char i;
+
+	for(i=0; i<W5500SIM_SOCKETS; i++)
+	{
+		memset(&bridgeSockets[i], 0, sizeof(bridgeSockets[i]));
+		bridgeSockets[i].fd = -1;
+		bridgeListeners[i].fd = -1;
+		bridgeListeners[i].port = 0;
+	}
+	memset(&bridgeCounters, 0, sizeof(bridgeCounters));
+	bridgePortOffset = portOffset;
+	bridgeLastPollNs = w5500simNowNs();
+	bridgeRealTime = realTime;
+	bridgeStartNs = bridgeWallNs() - w5500simNowNs();
+
+	w5500simSetPeer(&bridgePeer);
+	return OK;
+}
+
+void w5500bridgeShutdown(void)
+{
+	unsigned char i;
+
+	for(i=0; i<W5500SIM_SOCKETS; i++)
+	{
+		bridgeRelease(i, 1);
+		if(bridgeListeners[i].fd >= 0)	close(bridgeListeners[i].fd);
+		bridgeListeners[i].fd = -1;
+	}
+	w5500simSetPeer(NULL);
+}
+
+void w5500bridgeGetCounters(W5500bridgeCounters *counters)
+{
+	*counters = bridgeCounters;
+}
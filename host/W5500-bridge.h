@@ -0,0 +1,58 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @license GNU GPL v3
+ * @brief   Bridge from the host W5500 model to Linux TCP sockets
+ * @verbatim
+	Emulated W5500 sockets backed by real localhost listeners and connections
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#ifndef W5500_BRIDGE_H_
+#define W5500_BRIDGE_H_
+
+#define W5500BRIDGE_PORT_OFFSET			8000	//W5500 port 80 is served on 127.0.0.1:8080
+#define W5500BRIDGE_POLL_INTERVAL_NS	50000ULL//poll Linux sockets every 50 us of modeled time
+#define W5500BRIDGE_BACKLOG				128
+#define W5500BRIDGE_REALTIME_SLACK_NS	200000ULL//modeled time may run ahead of wall clock by this much
+
+
+typedef struct
+{
+	unsigned long accepted;			//connections handed to a W5500 socket in LISTEN
+	unsigned long connected;		//CONNECT commands completed
+	unsigned long connectFailed;	//CONNECT commands refused by the remote side
+	unsigned long finByDevice;		//DISCON issued by the driver
+	unsigned long resetByDevice;	//CLOSE issued on a connected socket
+	unsigned long finByRemote;		//EOF read from the Linux socket
+	unsigned long resetByRemote;	//read/write error on the Linux socket
+	unsigned long long bytesToDevice;
+	unsigned long long bytesFromDevice;
+}W5500bridgeCounters;
+
+
+//Installs the bridge as peer of the W5500 model.
+//Listening W5500 sockets get a listener on 127.0.0.1:(port + portOffset), CONNECT goes to 127.0.0.1:(port + portOffset).
+//Connections waiting in the Linux backlog are accepted only when some W5500 socket listens on that port.
+//With realTime set, modeled MCU time is paced to the wall clock, so loop-count timeouts and latencies match the board.
+unsigned char w5500bridgeInit(unsigned int portOffset, unsigned char realTime);
+void w5500bridgePoll(void);//accept, connect and receive; also called automatically as modeled time advances
+void w5500bridgeShutdown(void);
+void w5500bridgeGetCounters(W5500bridgeCounters *counters);
+
+#endif /* W5500_BRIDGE_H_ */
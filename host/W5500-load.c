@@ -0,0 +1,259 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @license GNU GPL v3
+ * @brief   End-to-end load test of TCPserver through the Linux socket bridge
+ * @verbatim
+	Unmodified TCPserver/serverProcessReceivedData driven by a local HTTP load generator
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "W5500-sim.h"
+#include "W5500-bridge.h"
+#include "W5500.h"
+
+
+#define LOAD_SERVER_PORT	80
+#define LOAD_MAX_SOCKETS	8
+#define LOAD_RECV_TIMEOUT_S	5
+
+static const unsigned char loadServerSockets[LOAD_MAX_SOCKETS] = {SOC0_REG, SOC1_REG, SOC2_REG, SOC3_REG, SOC4_REG, SOC5_REG, SOC6_REG, SOC7_REG};
+
+static unsigned int optConnections = 4;
+static unsigned long optRequests = 200;
+static unsigned int optSockets = 4;
+static unsigned int optPortOffset = W5500BRIDGE_PORT_OFFSET;
+static const char *optPath = "/";
+static unsigned char optServeOnly;
+static unsigned char optRealTime = 1;
+
+static double *latencies;//microseconds, one per request
+static unsigned long nextRequest;
+static unsigned long completed;
+static unsigned long failed;
+static pthread_mutex_t loadLock = PTHREAD_MUTEX_INITIALIZER;
+static volatile sig_atomic_t loadDone;
+
+
+static double loadNowUs(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
+
+//one connection per request, the library always closes after the response
+static unsigned char loadRequest(void)
+{
+	struct sockaddr_in addr;
+	struct timeval timeout = {LOAD_RECV_TIMEOUT_S, 0};
+	char request[128], response[512];
+	ssize_t received;
+	size_t total = 0;
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if(fd < 0)	return FAIL;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(LOAD_SERVER_PORT + optPortOffset);
+	if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		close(fd);
+		return FAIL;
+	}
+
+	snprintf(request, sizeof(request), "GET %s HTTP/1.0\r\nHost: 127.0.0.1\r\n\r\n", optPath);
+	if(send(fd, request, strlen(request), MSG_NOSIGNAL) < 0)
+	{
+		close(fd);
+		return FAIL;
+	}
+
+	while((received = recv(fd, response + total, sizeof(response) - 1 - total, 0)) > 0)//read until FIN from the device
+	{
+		total += received;
+		if(total == sizeof(response) - 1)	total = 0;//only the beginning is checked
+	}
+	close(fd);
+	response[total] = '\0';
+
+	return (received == 0 && total > 0) ? OK : FAIL;
+}
+
+static void *loadWorker(void *unused)
+{
+	unsigned long index;
+	double start;
+
+	while(1)
+	{
+		pthread_mutex_lock(&loadLock);
+		index = nextRequest++;
+		pthread_mutex_unlock(&loadLock);
+		if(index >= optRequests)	break;
+
+		start = loadNowUs();
+		if(loadRequest() == OK)
+		{
+			pthread_mutex_lock(&loadLock);
+			latencies[completed++] = loadNowUs() - start;
+			pthread_mutex_unlock(&loadLock);
+		}
+		else
+		{
+			pthread_mutex_lock(&loadLock);
+			failed++;
+			pthread_mutex_unlock(&loadLock);
+		}
+	}
+	return NULL;
+}
+
+static void *loadGenerator(void *unused)
+{
+	pthread_t workers[256];
+	unsigned int i;
+
+	for(i=0; i<optConnections; i++)	pthread_create(&workers[i], NULL, loadWorker, NULL);
+	for(i=0; i<optConnections; i++)	pthread_join(workers[i], NULL);
+	loadDone = 1;
+	return NULL;
+}
+
+static int loadCompare(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static void loadServe(void)
+{
+	unsigned int i;
+
+	for(i=0; i<optSockets; i++)
+	{
+		TCPserver(loadServerSockets[i], LOAD_SERVER_PORT);
+	}
+	w5500bridgePoll();
+}
+
+static void loadStop(int signal)
+{
+	loadDone = 1;
+}
+
+static void loadUsage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-c connections] [-n requests] [-s W5500 sockets] [-o port offset] [-u path] [-x] [-f]\n", name);
+	fprintf(stderr, "  -x  serve only, for an external load generator (wrk, ab) on 127.0.0.1:%u\n", LOAD_SERVER_PORT + W5500BRIDGE_PORT_OFFSET);
+	fprintf(stderr, "  -f  free running, modeled MCU time is not paced to the wall clock (loop-count timeouts expire early)\n");
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	address IPaddress = {IP0, IP1, IP2, IP3};
+	address mask = {MASK0, MASK1, MASK2, MASK3};
+	address gateway = {GW0, GW1, GW2, GW3};
+	MACaddress MACadr = {MAC0, MAC1, MAC2, MAC3, MAC4, MAC5};
+	W5500simCounters sim;
+	W5500bridgeCounters bridge;
+	pthread_t generator;
+	double start, elapsed;
+	int option;
+
+	while((option = getopt(argc, argv, "c:n:s:o:u:xf")) != -1)
+	{
+		switch(option)
+		{
+			case 'c': optConnections = atoi(optarg); break;
+			case 'n': optRequests = strtoul(optarg, NULL, 10); break;
+			case 's': optSockets = atoi(optarg); break;
+			case 'o': optPortOffset = atoi(optarg); break;
+			case 'u': optPath = optarg; break;
+			case 'x': optServeOnly = 1; break;
+			case 'f': optRealTime = 0; break;
+			default: loadUsage(argv[0]);
+		}
+	}
+	if(optConnections < 1 || optConnections > 256 || optSockets < 1 || optSockets > LOAD_MAX_SOCKETS || optRequests < 1)	loadUsage(argv[0]);
+
+	w5500simReset();
+	w5500bridgeInit(optPortOffset, optRealTime);
+	ethernetInit(IPaddress, mask, gateway, MACadr);
+	loadServe();//all server sockets to LISTEN, listener is up
+
+	signal(SIGINT, loadStop);
+	if(optServeOnly)
+	{
+		printf("serving on 127.0.0.1:%u with %u W5500 sockets, Ctrl+C to stop\n", LOAD_SERVER_PORT + optPortOffset, optSockets);
+		while(!loadDone)	loadServe();
+		optRequests = 0;
+	}
+	else
+	{
+		latencies = calloc(optRequests, sizeof(double));
+		start = loadNowUs();
+		pthread_create(&generator, NULL, loadGenerator, NULL);
+		while(!loadDone)	loadServe();
+		pthread_join(generator, NULL);
+		elapsed = loadNowUs() - start;
+
+		qsort(latencies, completed, sizeof(double), loadCompare);
+		printf("requests        %lu completed, %lu failed, %u connections, %u W5500 sockets\n", completed, failed, optConnections, optSockets);
+		printf("throughput      %.1f requests/s (%s)\n", completed / (elapsed / 1e6), optRealTime ? "paced to modeled MCU time" : "free running host");
+		if(completed)
+		{
+			printf("latency         p50 %.1f us, p99 %.1f us, max %.1f us\n", latencies[completed / 2], latencies[(completed * 99) / 100], latencies[completed - 1]);
+		}
+		free(latencies);
+	}
+
+	w5500simGetCounters(&sim);
+	w5500bridgeGetCounters(&bridge);
+	printf("connections     %lu accepted, %lu FIN by device, %lu FIN by client, %lu RST by device, %lu RST by client\n",
+		bridge.accepted, bridge.finByDevice, bridge.finByRemote, bridge.resetByDevice, bridge.resetByRemote);
+	printf("bytes           %llu to device, %llu from device\n", bridge.bytesToDevice, bridge.bytesFromDevice);
+	if(bridge.accepted)
+	{
+		printf("per connection  %.1f SPI bytes, %.1f CS cycles, %.2f SENDs, %.1f modeled MCU us\n",
+			(double)sim.spiBytes / bridge.accepted, (double)sim.csCycles / bridge.accepted,
+			(double)sim.sendCommands / bridge.accepted, sim.modeledNs / 1e3 / bridge.accepted);
+		printf("modeled limit   %.1f connections/s for the MCU\n", bridge.accepted / (sim.modeledNs / 1e9));
+	}
+
+	w5500bridgeShutdown();
+	return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,662 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @license GNU GPL v3
+ * @brief   Host-side W5500 register/SPI model for Linux builds of the library
+ * @verbatim
+	Cycle-accounting Wiznet W5500 model - replaces SPIE_*, PORTE_* and _delay_* layer
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "W5500-sim.h"
+
+
+//XMEGA registers the driver writes directly, see host/avr/io.h
+volatile unsigned char SPIE_DATA;
+volatile unsigned char SPIE_CTRL;
+volatile unsigned char SPIE_INTCTRL;
+volatile unsigned char PORTE_DIRSET;
+volatile unsigned char PORTE_DIRCLR;
+volatile unsigned char PORTE_OUTSET;
+volatile unsigned char PORTE_OUTCLR;
+volatile unsigned int TCC0_PER;
+volatile unsigned char TCC0_CTRLA;
+volatile unsigned int TCD0_PER;
+volatile unsigned char TCD0_CTRLA;
+volatile unsigned char TCD0_INTCTRLA;
+volatile unsigned char PMIC_CTRL;
+volatile unsigned char SREG;
+
+void w5500simTCD0overflow(void) __attribute__((weak));//ISR(TCD0_OVF_vect), if the application has one
+
+
+//W5500 register map used by the model (names prefixed, W5500.h is not included here)
+#define SIM_MR				0x00
+#define SIM_MR_RST			0x80
+#define SIM_RTR0			0x19
+#define SIM_RCR				0x1B
+#define SIM_PHYCFGR			0x2E
+#define SIM_PHYCFGR_RST		0x80	//0 = PHY in reset
+#define SIM_PHYCFGR_OPMD	0x40	//operation mode from OPMDC bits, otherwise from PMODE pins (all capable)
+#define SIM_PHYCFGR_STATUS	0x07	//DPX, SPD, LNK - read only
+#define SIM_VERSIONR		0x39
+
+#define SIM_Sn_MR			0x00
+#define SIM_Sn_CR			0x01
+#define SIM_Sn_SR			0x03
+#define SIM_Sn_PORT0		0x04
+#define SIM_Sn_DIPR0		0x0C
+#define SIM_Sn_DPORT0		0x10
+#define SIM_Sn_TTL			0x16
+#define SIM_Sn_RXBUF_SIZE	0x1E
+#define SIM_Sn_TXBUF_SIZE	0x1F
+#define SIM_Sn_TX_FSR0		0x20
+#define SIM_Sn_TX_RD0		0x22
+#define SIM_Sn_TX_WR0		0x24
+#define SIM_Sn_RX_RSR0		0x26
+#define SIM_Sn_RX_RD0		0x28
+#define SIM_Sn_RX_WR0		0x2A
+#define SIM_Sn_KPALVTR		0x2F
+
+#define SIM_Sn_MR_TCP		0x01
+#define SIM_Sn_MR_UDP		0x02
+
+#define SIM_CR_OPEN			0x01
+#define SIM_CR_LISTEN		0x02
+#define SIM_CR_CONNECT		0x04
+#define SIM_CR_DISCON		0x08
+#define SIM_CR_CLOSE		0x10
+#define SIM_CR_SEND			0x20
+#define SIM_CR_RECV			0x40
+
+#define SIM_SOCK_CLOSED			0x00
+#define SIM_SOCK_INIT			0x13
+#define SIM_SOCK_LISTEN			0x14
+#define SIM_SOCK_SYNSENT		0x15
+#define SIM_SOCK_ESTABLISHED	0x17
+#define SIM_SOCK_FIN_WAIT		0x18
+#define SIM_SOCK_CLOSE_WAIT		0x1C
+#define SIM_SOCK_UDP			0x22
+
+#define SIM_UDP_HEADER			8	//source IP, port and length in front of every received datagram
+
+#define SIM_BLOCK_REG		1
+#define SIM_BLOCK_TXBUF		2
+#define SIM_BLOCK_RXBUF		3
+
+
+typedef struct
+{
+	unsigned char reg[W5500SIM_SOCKET_REGS];
+	unsigned char status;
+	unsigned int txRd;
+	unsigned int rxWr;
+	unsigned int rxRd;//value latched by RECV command, Sn_RX_RD register holds the one written by MCU
+	unsigned long long deadlineNs;//SYNSENT/FIN_WAIT timeout, 0 = none
+	unsigned char keepAlive;//Sn_KPALVTR latched by LISTEN/CONNECT, later writes do not apply to the connection
+}W5500simSocket;
+
+static unsigned char commonReg[W5500SIM_COMMON_REGS];
+static W5500simSocket sockets[W5500SIM_SOCKETS];
+static unsigned char txMemory[W5500SIM_BUFFER_MEMORY/2];
+static unsigned char rxMemory[W5500SIM_BUFFER_MEMORY/2];
+
+static unsigned char frameSelected;
+static unsigned char framePhase;
+static unsigned int frameAddress;
+static unsigned char frameControl;
+
+static W5500simCounters counters;
+static unsigned long long nowNs;
+static const W5500simPeer *simPeer;
+static unsigned char uartEcho;
+static unsigned char advancing;
+static unsigned long long timerNextNs;//next TCD0 overflow, 0 = timer stopped
+static unsigned char linkDown;//cable unplugged, link partner is 100 Mbps full duplex otherwise
+
+
+static unsigned int reg16(unsigned char *reg)
+{
+	return (reg[0] << 8) | reg[1];
+}
+
+static void simResetRegisters(void)
+{
+	unsigned char i;
+
+	memset(commonReg, 0, sizeof(commonReg));
+	commonReg[SIM_RTR0] = 0x07;//200 ms
+	commonReg[SIM_RTR0+1] = 0xD0;
+	commonReg[SIM_RCR] = 0x08;
+	commonReg[SIM_PHYCFGR] = 0xB8;//all capable auto-negotiation, status bits are computed on read
+	commonReg[SIM_VERSIONR] = 0x04;
+
+	for(i=0; i<W5500SIM_SOCKETS; i++)
+	{
+		memset(&sockets[i], 0, sizeof(sockets[i]));
+		sockets[i].reg[SIM_Sn_TTL] = 0x80;
+		sockets[i].reg[SIM_Sn_RXBUF_SIZE] = 2;//2 KB
+		sockets[i].reg[SIM_Sn_TXBUF_SIZE] = 2;
+	}
+	memset(txMemory, 0, sizeof(txMemory));
+	memset(rxMemory, 0, sizeof(rxMemory));
+}
+
+//returns offset of socket buffer in TX or RX memory and its size
+static unsigned int simBufferBase(unsigned char socketNumber, unsigned char sizeReg, unsigned int *size)
+{
+	unsigned int base = 0;
+	unsigned char i;
+
+	for(i=0; i<socketNumber; i++)
+	{
+		base += sockets[i].reg[sizeReg] * 1024U;
+	}
+	*size = sockets[socketNumber].reg[sizeReg] * 1024U;
+	if(base + *size > sizeof(txMemory))	*size = 0;//invalid memory configuration, buffer not mapped
+
+	return base;
+}
+
+static unsigned int simTxUsed(W5500simSocket *s)
+{
+	return (reg16(&s->reg[SIM_Sn_TX_WR0]) - s->txRd) & 0xFFFF;
+}
+
+static unsigned int simRxUsed(W5500simSocket *s)
+{
+	return (s->rxWr - s->rxRd) & 0xFFFF;
+}
+
+//PHYCFGR status bits for the configured operation mode
+static unsigned char simPHYstatus(void)
+{
+	unsigned char config = commonReg[SIM_PHYCFGR];
+	unsigned char mode = (config & SIM_PHYCFGR_OPMD) ? (config >> 3) & 0b111 : 0b111;
+
+	if(linkDown || !(config & SIM_PHYCFGR_RST) || mode == 0b110 || mode == 0b101)	return 0;//no link, PHY reset, power down, reserved
+
+	switch(mode)
+	{
+		case 0b000:	return 0b001;//10 Mbps half duplex
+		case 0b001:	return 0b101;
+		case 0b010:
+		case 0b100:	return 0b011;//100 Mbps half duplex
+		default:	return 0b111;//100 Mbps full duplex, forced or negotiated with the partner
+	}
+}
+
+//TCD0 overflow interrupt, CLK/64 only
+static void simTimer(void)
+{
+	unsigned long long periodNs = (TCD0_PER + 1ULL) * 64ULL * 1000000000ULL / W5500SIM_F_CPU;
+
+	if(TCD0_CTRLA == 0 || (TCD0_INTCTRLA & 0b11) == 0 || !w5500simTCD0overflow)
+	{
+		timerNextNs = 0;
+		return;
+	}
+	if(timerNextNs == 0)	timerNextNs = nowNs + periodNs;
+
+	while(nowNs >= timerNextNs)
+	{
+		w5500simTCD0overflow();
+		timerNextNs += periodNs;
+	}
+}
+
+static void simAdvance(unsigned long long ns)
+{
+	unsigned char i;
+
+	nowNs += ns;
+	counters.modeledNs += ns;
+
+	simTimer();
+
+	for(i=0; i<W5500SIM_SOCKETS; i++)
+	{
+		if(sockets[i].deadlineNs && nowNs >= sockets[i].deadlineNs)
+		{
+			sockets[i].deadlineNs = 0;
+			if(sockets[i].status != SIM_SOCK_CLOSED && sockets[i].status != SIM_SOCK_LISTEN && sockets[i].status != SIM_SOCK_UDP)
+			{
+				sockets[i].status = SIM_SOCK_CLOSED;//retransmission timeout
+			}
+		}
+	}
+
+	if(simPeer && simPeer->advance && !advancing)
+	{
+		advancing = 1;//peer may call back into the model
+		simPeer->advance(nowNs);
+		advancing = 0;
+	}
+}
+
+static void simSend(unsigned char socketNumber)
+{
+	W5500simSocket *s = &sockets[socketNumber];
+	unsigned char data[W5500SIM_BUFFER_MEMORY/2];
+	unsigned int size, i;
+	unsigned int base = simBufferBase(socketNumber, SIM_Sn_TXBUF_SIZE, &size);
+	unsigned int length = simTxUsed(s);
+
+	counters.sendCommands++;
+	if(size == 0)	return;
+	if(length > size)	length = size;
+
+	for(i=0; i<length; i++)
+	{
+		data[i] = txMemory[base + ((s->txRd + i) & (size - 1))];
+	}
+	s->txRd = (s->txRd + length) & 0xFFFF;
+
+	if(linkDown)//lost, TCP gives up after the retransmission timeout unless the link comes back
+	{
+		if(s->status != SIM_SOCK_UDP && !s->deadlineNs)	s->deadlineNs = nowNs + W5500SIM_TCP_TIMEOUT_NS;
+		return;
+	}
+	if(s->status == SIM_SOCK_UDP)
+	{
+		if(simPeer && simPeer->datagram && length)	simPeer->datagram(socketNumber, &s->reg[SIM_Sn_DIPR0], reg16(&s->reg[SIM_Sn_DPORT0]), data, length);
+		return;
+	}
+	if(simPeer && simPeer->send && length)	simPeer->send(socketNumber, data, length);
+}
+
+static void simCommand(unsigned char socketNumber, unsigned char command)
+{
+	W5500simSocket *s = &sockets[socketNumber];
+	unsigned char previous = s->status;
+
+	counters.commands++;
+
+	switch(command)
+	{
+		case SIM_CR_OPEN:
+			if((s->reg[SIM_Sn_MR] & 0x0F) == SIM_Sn_MR_TCP || (s->reg[SIM_Sn_MR] & 0x0F) == SIM_Sn_MR_UDP)
+			{
+				s->status = ((s->reg[SIM_Sn_MR] & 0x0F) == SIM_Sn_MR_TCP) ? SIM_SOCK_INIT : SIM_SOCK_UDP;
+				s->txRd = 0;
+				s->rxWr = 0;
+				s->rxRd = 0;
+				s->deadlineNs = 0;
+				memset(&s->reg[SIM_Sn_TX_RD0], 0, SIM_Sn_RX_WR0 + 2 - SIM_Sn_TX_RD0);
+			}
+			break;
+
+		case SIM_CR_LISTEN:
+			if(previous == SIM_SOCK_INIT)
+			{
+				s->status = SIM_SOCK_LISTEN;
+				s->keepAlive = s->reg[SIM_Sn_KPALVTR];
+				if(simPeer && simPeer->listen)	simPeer->listen(socketNumber, reg16(&s->reg[SIM_Sn_PORT0]));
+			}
+			break;
+
+		case SIM_CR_CONNECT:
+			if(previous == SIM_SOCK_INIT)
+			{
+				s->status = SIM_SOCK_SYNSENT;
+				s->keepAlive = s->reg[SIM_Sn_KPALVTR];
+				s->deadlineNs = nowNs + W5500SIM_TCP_TIMEOUT_NS;
+				if(simPeer && simPeer->connect)	simPeer->connect(socketNumber, &s->reg[SIM_Sn_DIPR0], reg16(&s->reg[SIM_Sn_DPORT0]));
+			}
+			break;
+
+		case SIM_CR_DISCON:
+			if(previous == SIM_SOCK_ESTABLISHED)
+			{
+				s->status = SIM_SOCK_FIN_WAIT;
+				s->deadlineNs = nowNs + W5500SIM_TCP_TIMEOUT_NS;
+				if(simPeer && simPeer->disconnect)	simPeer->disconnect(socketNumber);
+			}
+			else if(previous == SIM_SOCK_CLOSE_WAIT)
+			{
+				s->status = SIM_SOCK_CLOSED;//LAST_ACK is acknowledged immediately
+				if(simPeer && simPeer->disconnect)	simPeer->disconnect(socketNumber);
+			}
+			break;
+
+		case SIM_CR_CLOSE:
+			s->status = SIM_SOCK_CLOSED;
+			s->deadlineNs = 0;
+			if(previous != SIM_SOCK_CLOSED && previous != SIM_SOCK_INIT && previous != SIM_SOCK_UDP && simPeer && simPeer->close)	simPeer->close(socketNumber);
+			break;
+
+		case SIM_CR_SEND:
+			if(previous == SIM_SOCK_ESTABLISHED || previous == SIM_SOCK_CLOSE_WAIT || previous == SIM_SOCK_UDP)	simSend(socketNumber);
+			break;
+
+		case SIM_CR_RECV:
+			s->rxRd = reg16(&s->reg[SIM_Sn_RX_RD0]);
+			break;
+	}
+}
+
+static unsigned char simSocketRead(unsigned char socketNumber, unsigned int address)
+{
+	W5500simSocket *s = &sockets[socketNumber];
+	unsigned int size, value;
+
+	switch(address)
+	{
+		case SIM_Sn_CR:			return 0;//commands are executed immediately
+		case SIM_Sn_SR:			return s->status;
+		case SIM_Sn_TX_FSR0:
+		case SIM_Sn_TX_FSR0+1:
+			simBufferBase(socketNumber, SIM_Sn_TXBUF_SIZE, &size);
+			value = size - simTxUsed(s);
+			return (address == SIM_Sn_TX_FSR0) ? (value >> 8) : (value & 0xFF);
+		case SIM_Sn_TX_RD0:		return s->txRd >> 8;
+		case SIM_Sn_TX_RD0+1:	return s->txRd & 0xFF;
+		case SIM_Sn_RX_RSR0:	return simRxUsed(s) >> 8;
+		case SIM_Sn_RX_RSR0+1:	return simRxUsed(s) & 0xFF;
+		case SIM_Sn_RX_WR0:		return s->rxWr >> 8;
+		case SIM_Sn_RX_WR0+1:	return s->rxWr & 0xFF;
+	}
+
+	if(address < W5500SIM_SOCKET_REGS)	return s->reg[address];
+	return 0;
+}
+
+static void simSocketWrite(unsigned char socketNumber, unsigned int address, unsigned char data)
+{
+	switch(address)
+	{
+		case SIM_Sn_CR:			simCommand(socketNumber, data); return;
+		case SIM_Sn_SR:
+		case SIM_Sn_TX_FSR0:
+		case SIM_Sn_TX_FSR0+1:
+		case SIM_Sn_TX_RD0:
+		case SIM_Sn_TX_RD0+1:
+		case SIM_Sn_RX_RSR0:
+		case SIM_Sn_RX_RSR0+1:
+		case SIM_Sn_RX_WR0:
+		case SIM_Sn_RX_WR0+1:	return;//read only
+	}
+
+	if(address < W5500SIM_SOCKET_REGS)	sockets[socketNumber].reg[address] = data;
+}
+
+static unsigned char *simBufferByte(unsigned char socketNumber, unsigned char block, unsigned int address)
+{
+	unsigned int size, base;
+
+	if(block == SIM_BLOCK_TXBUF)
+	{
+		base = simBufferBase(socketNumber, SIM_Sn_TXBUF_SIZE, &size);
+		return size ? &txMemory[base + (address & (size - 1))] : NULL;
+	}
+	base = simBufferBase(socketNumber, SIM_Sn_RXBUF_SIZE, &size);
+	return size ? &rxMemory[base + (address & (size - 1))] : NULL;
+}
+
+static unsigned char simRead(unsigned char bsb, unsigned int address)
+{
+	unsigned char *byte;
+
+	if(bsb == 0 && address == SIM_PHYCFGR)	return (commonReg[SIM_PHYCFGR] & ~SIM_PHYCFGR_STATUS) | simPHYstatus();
+	if(bsb == 0)	return (address < W5500SIM_COMMON_REGS) ? commonReg[address] : 0;
+
+	switch(bsb & 0b11)
+	{
+		case SIM_BLOCK_REG:		return simSocketRead(bsb >> 2, address);
+		case SIM_BLOCK_TXBUF:
+		case SIM_BLOCK_RXBUF:
+			byte = simBufferByte(bsb >> 2, bsb & 0b11, address);
+			return byte ? *byte : 0;
+	}
+	return 0;//reserved block
+}
+
+static void simWrite(unsigned char bsb, unsigned int address, unsigned char data)
+{
+	unsigned char *byte;
+
+	if(bsb == 0)
+	{
+		if(address == SIM_MR && (data & SIM_MR_RST))
+		{
+			simResetRegisters();//software reset, self clearing
+		}
+		else if(address < SIM_VERSIONR)
+		{
+			commonReg[address] = data;
+		}
+		return;
+	}
+
+	switch(bsb & 0b11)
+	{
+		case SIM_BLOCK_REG:		simSocketWrite(bsb >> 2, address, data); break;
+		case SIM_BLOCK_TXBUF:
+		case SIM_BLOCK_RXBUF:
+			byte = simBufferByte(bsb >> 2, bsb & 0b11, address);
+			if(byte)	*byte = data;
+			break;
+	}
+}
+
+static unsigned char simTransfer(unsigned char mosi)
+{
+	unsigned char miso = 0;
+
+	counters.spiBytes++;
+	simAdvance(W5500SIM_SPI_BYTE_NS + W5500SIM_SPI_OVERHEAD_NS);
+
+	if(!frameSelected)	return 0xFF;//MISO is tri-stated
+
+	switch(framePhase)
+	{
+		case 0: frameAddress = mosi << 8; miso = 0x01; framePhase++; break;
+		case 1: frameAddress |= mosi; miso = 0x02; framePhase++; break;
+		case 2: frameControl = mosi; miso = 0x03; framePhase++; break;
+		default:
+			if(frameControl & 0b00000100)	simWrite(frameControl >> 3, frameAddress, mosi);
+			else							miso = simRead(frameControl >> 3, frameAddress);
+			frameAddress = (frameAddress + 1) & 0xFFFF;
+			break;
+	}
+	return miso;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//Platform layer
+
+unsigned char w5500simSPIstatus(void)
+{
+	if(PORTE_OUTSET & W5500SIM_CS_PIN)//CS_DISABLE() since last transfer
+	{
+		frameSelected = 0;
+	}
+	if(PORTE_OUTCLR & W5500SIM_CS_PIN)//CS_ENABLE() since last transfer
+	{
+		frameSelected = 1;
+		framePhase = 0;
+		counters.csCycles++;
+	}
+	PORTE_OUTSET = 0;
+	PORTE_OUTCLR = 0;
+
+	SPIE_DATA = simTransfer(SPIE_DATA);
+	return 0b10000000;//SPI_IF, transfer complete
+}
+
+void w5500simDelayUs(double us)
+{
+	simAdvance((unsigned long long)(us * 1000.0));
+}
+
+void w5500simUARTbyte(unsigned char data)
+{
+	counters.uartBytes++;
+	if(uartEcho)	putchar(data);
+	simAdvance(10ULL * 1000000000ULL / W5500SIM_UART_BAUDRATE);//start + 8 data + stop bit
+}
+
+//////////////////////////////////////////////////////////////////////////
+//Model control
+
+void w5500simReset(void)
+{
+	simResetRegisters();
+	memset(&counters, 0, sizeof(counters));
+	nowNs = 0;
+	timerNextNs = 0;
+	frameSelected = 0;
+	framePhase = 0;
+	PORTE_OUTSET = 0;
+	PORTE_OUTCLR = 0;
+}
+
+void w5500simSetPeer(const W5500simPeer *peer)
+{
+	simPeer = peer;
+}
+
+void w5500simGetCounters(W5500simCounters *counters_)
+{
+	*counters_ = counters;
+}
+
+void w5500simSetUARTecho(unsigned char enable)
+{
+	uartEcho = enable;
+}
+
+void w5500simSetLink(unsigned char up)
+{
+	unsigned char i;
+
+	linkDown = !up;
+	if(!up)	return;
+	for(i=0; i<W5500SIM_SOCKETS; i++)//retransmissions get through, data sent while down is not replayed to the peer
+	{
+		if(sockets[i].status == SIM_SOCK_ESTABLISHED || sockets[i].status == SIM_SOCK_CLOSE_WAIT)	sockets[i].deadlineNs = 0;
+	}
+}
+
+unsigned long long w5500simNowNs(void)
+{
+	return nowNs;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//Remote side
+
+unsigned char w5500simStatus(unsigned char socketNumber)
+{
+	return sockets[socketNumber].status;
+}
+
+unsigned char w5500simKeepAlive(unsigned char socketNumber)
+{
+	return sockets[socketNumber].keepAlive;
+}
+
+unsigned int w5500simLocalPort(unsigned char socketNumber)
+{
+	return reg16(&sockets[socketNumber].reg[SIM_Sn_PORT0]);
+}
+
+unsigned char w5500simAccept(unsigned char socketNumber)
+{
+	if(sockets[socketNumber].status != SIM_SOCK_LISTEN)	return 0;
+	sockets[socketNumber].status = SIM_SOCK_ESTABLISHED;
+	return 1;
+}
+
+unsigned char w5500simEstablish(unsigned char socketNumber)
+{
+	if(sockets[socketNumber].status != SIM_SOCK_SYNSENT)	return 0;
+	sockets[socketNumber].status = SIM_SOCK_ESTABLISHED;
+	sockets[socketNumber].deadlineNs = 0;
+	return 1;
+}
+
+unsigned int w5500simDeliver(unsigned char socketNumber, const unsigned char *data, unsigned int length)
+{
+	W5500simSocket *s = &sockets[socketNumber];
+	unsigned int size, i;
+	unsigned int base = simBufferBase(socketNumber, SIM_Sn_RXBUF_SIZE, &size);
+
+	if(s->status != SIM_SOCK_ESTABLISHED && s->status != SIM_SOCK_FIN_WAIT)	return 0;
+	if(length > size - simRxUsed(s))	length = size - simRxUsed(s);//receive window full
+
+	for(i=0; i<length; i++)
+	{
+		rxMemory[base + ((s->rxWr + i) & (size - 1))] = data[i];
+	}
+	s->rxWr = (s->rxWr + length) & 0xFFFF;
+
+	return length;
+}
+
+unsigned int w5500simDeliverDatagram(unsigned char socketNumber, const unsigned char ip[4], unsigned int port, const unsigned char *data, unsigned int length)
+{
+	W5500simSocket *s = &sockets[socketNumber];
+	unsigned char header[SIM_UDP_HEADER];
+	unsigned int size, i;
+	unsigned int base = simBufferBase(socketNumber, SIM_Sn_RXBUF_SIZE, &size);
+
+	if(s->status != SIM_SOCK_UDP)	return 0;
+	if(SIM_UDP_HEADER + length > size - simRxUsed(s))	return 0;//datagram does not fit, dropped as a whole
+
+	memcpy(header, ip, 4);
+	header[4] = port >> 8;
+	header[5] = port & 0xFF;
+	header[6] = length >> 8;
+	header[7] = length & 0xFF;
+	for(i=0; i<SIM_UDP_HEADER + length; i++)
+	{
+		rxMemory[base + ((s->rxWr + i) & (size - 1))] = (i < SIM_UDP_HEADER) ? header[i] : data[i - SIM_UDP_HEADER];
+	}
+	s->rxWr = (s->rxWr + SIM_UDP_HEADER + length) & 0xFFFF;
+
+	return length;
+}
+
+unsigned char w5500simRemoteClose(unsigned char socketNumber)
+{
+	W5500simSocket *s = &sockets[socketNumber];
+
+	if(s->status == SIM_SOCK_ESTABLISHED)
+	{
+		s->status = SIM_SOCK_CLOSE_WAIT;
+		return 1;
+	}
+	if(s->status == SIM_SOCK_FIN_WAIT)
+	{
+		s->status = SIM_SOCK_CLOSED;//TIME_WAIT is not modeled
+		s->deadlineNs = 0;
+		return 1;
+	}
+	return 0;
+}
+
+unsigned char w5500simRemoteReset(unsigned char socketNumber)
+{
+	if(sockets[socketNumber].status == SIM_SOCK_CLOSED)	return 0;
+	sockets[socketNumber].status = SIM_SOCK_CLOSED;
+	sockets[socketNumber].deadlineNs = 0;
+	return 1;
+}
@@ -0,0 +1,95 @@
+/**
+ * @author  Lukas Herudek
+ * @email   lukas.herudek@gmail.com
+ * @version v1.0
+ * @license GNU GPL v3
+ * @brief   Host-side W5500 register/SPI model for Linux builds of the library
+ * @verbatim
+	Cycle-accounting Wiznet W5500 model - replaces SPIE_*, PORTE_* and _delay_* layer
+   ----------------------------------------------------------------------
+    Copyright (C) Lukas Herudek, 2018
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+	See the GNU General Public License for more details.
+
+	<http://www.gnu.org/licenses/>
+@endverbatim
+ */
+
+#ifndef W5500_SIM_H_
+#define W5500_SIM_H_
+
+#define W5500SIM_SOCKETS			8
+#define W5500SIM_COMMON_REGS		0x40
+#define W5500SIM_SOCKET_REGS		0x30
+#define W5500SIM_BUFFER_MEMORY		32768UL	//16 KB TX + 16 KB RX
+
+#define W5500SIM_CS_PIN				0b00010000	//PORTE pin 4, see CS_ENABLE() in W5500.c
+
+//timing model (XMEGA @ 32 MHz, SPI prescaler DIV4 = 8 MHz SCK)
+#define W5500SIM_F_CPU				32000000ULL
+#define W5500SIM_SPI_BYTE_NS		1000ULL		//8 bits at 8 MHz
+#define W5500SIM_SPI_OVERHEAD_NS	125ULL		//DATA write + STATUS polling loop, cca 4 CPU cycles
+#define W5500SIM_UART_BAUDRATE		9600ULL		//must match UART_BAUDRATE in UART-XMEGA.h
+#define W5500SIM_TCP_TIMEOUT_NS		31800000000ULL	//RTR = 200 ms, RCR = 8 (reset values)
+
+
+typedef struct
+{
+	unsigned long long spiBytes;		//every byte clocked over SPI, including address and control phase
+	unsigned long long csCycles;		//number of SPI frames (CS low -> CS high)
+	unsigned long long commands;		//writes to Sn_CR
+	unsigned long long sendCommands;	//Sn_CR = SEND only
+	unsigned long long uartBytes;		//bytes written by UART_TX
+	unsigned long long modeledNs;		//modeled MCU time spent in SPI, UART and _delay_*
+}W5500simCounters;
+
+//Remote side of the emulated sockets, every callback is optional
+//socketNumber is 0..7 (not the SOCn_REG block code used by W5500.c)
+typedef struct
+{
+	void (*listen)(unsigned char socketNumber, unsigned int port);
+	void (*connect)(unsigned char socketNumber, const unsigned char ip[4], unsigned int port);
+	void (*send)(unsigned char socketNumber, const unsigned char *data, unsigned int length);
+	void (*disconnect)(unsigned char socketNumber);//FIN sent by the W5500
+	void (*close)(unsigned char socketNumber);//socket closed by the MCU (RST for connected sockets)
+	void (*advance)(unsigned long long nowNs);//modeled time moved forward
+	void (*datagram)(unsigned char socketNumber, const unsigned char ip[4], unsigned int port, const unsigned char *data, unsigned int length);//UDP SEND to Sn_DIPR:Sn_DPORT
+}W5500simPeer;
+
+
+//Model control
+
+void w5500simReset(void);//power-on reset of registers, buffer memory, counters and modeled time
+void w5500simSetPeer(const W5500simPeer *peer);
+void w5500simGetCounters(W5500simCounters *counters);
+void w5500simSetUARTecho(unsigned char enable);//copy UART_TX bytes to stdout
+void w5500simSetLink(unsigned char up);//cable plugged in or not, not changed by w5500simReset
+unsigned long long w5500simNowNs(void);
+
+//Platform layer used by host/avr/io.h, host/util/delay.h and host/UART-host.c
+
+unsigned char w5500simSPIstatus(void);
+void w5500simDelayUs(double us);
+void w5500simUARTbyte(unsigned char data);
+
+//Remote side actions, return 1 if the socket was in the right state
+
+unsigned char w5500simStatus(unsigned char socketNumber);
+unsigned char w5500simKeepAlive(unsigned char socketNumber);//Sn_KPALVTR in effect for the connection, 5 s units
+unsigned int w5500simLocalPort(unsigned char socketNumber);//Sn_PORT
+unsigned char w5500simAccept(unsigned char socketNumber);//LISTEN -> ESTABLISHED
+unsigned char w5500simEstablish(unsigned char socketNumber);//SYNSENT -> ESTABLISHED
+unsigned int w5500simDeliver(unsigned char socketNumber, const unsigned char *data, unsigned int length);//returns bytes stored in RX buffer
+unsigned int w5500simDeliverDatagram(unsigned char socketNumber, const unsigned char ip[4], unsigned int port, const unsigned char *data, unsigned int length);//UDP socket, 0 = dropped
+unsigned char w5500simRemoteClose(unsigned char socketNumber);//FIN from remote side
+unsigned char w5500simRemoteReset(unsigned char socketNumber);//RST from remote side
+
+#endif /* W5500_SIM_H_ */
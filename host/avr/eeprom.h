@@ -0,0 +1,14 @@
+/**
+ * @brief   avr/eeprom.h replacement for host builds, EEMEM variables live in RAM and survive w5500simReset()
+ */
+
+#ifndef HOST_AVR_EEPROM_H_
+#define HOST_AVR_EEPROM_H_
+
+#include <string.h>
+
+#define EEMEM
+#define eeprom_read_block(dst, src, n)		memcpy((dst), (src), (n))
+#define eeprom_update_block(src, dst, n)	memcpy((dst), (src), (n))
+
+#endif /* HOST_AVR_EEPROM_H_ */
@@ -0,0 +1,12 @@
+/**
+ * @brief   avr/interrupt.h replacement for host builds, interrupt vectors are called by the W5500 model
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#define ISR(vector)		void vector(void)
+#define sei()
+#define cli()
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
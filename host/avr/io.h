@@ -0,0 +1,43 @@
+/**
+ * @brief   avr/io.h replacement for host builds, XMEGA registers used by the library are backed by the W5500 model
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include "W5500-sim.h"
+
+extern volatile unsigned char SPIE_DATA;
+extern volatile unsigned char SPIE_CTRL;
+extern volatile unsigned char SPIE_INTCTRL;
+#define SPIE_STATUS		(w5500simSPIstatus())//every poll clocks out SPIE_DATA and latches MISO into it
+
+extern volatile unsigned char PORTE_DIRSET;
+extern volatile unsigned char PORTE_DIRCLR;
+extern volatile unsigned char PORTE_OUTSET;
+extern volatile unsigned char PORTE_OUTCLR;
+
+#define SPI_CLK2X_bm			0x80
+#define SPI_ENABLE_bm			0x40
+#define SPI_DORD_bm				0x20
+#define SPI_MASTER_bm			0x10
+#define SPI_MODE_0_gc			0x00
+#define SPI_PRESCALER_DIV4_gc	0x00
+
+extern volatile unsigned int TCC0_PER;
+extern volatile unsigned char TCC0_CTRLA;
+#define TCC0_CNT		((unsigned int)(w5500simNowNs() / 2000ULL) & 0xFFFF)//free running at CLK/64
+
+extern volatile unsigned int TCD0_PER;
+extern volatile unsigned char TCD0_CTRLA;
+extern volatile unsigned char TCD0_INTCTRLA;
+#define TCD0_OVF_vect	w5500simTCD0overflow//called by the model every TCD0 period, see ISR() in host/avr/interrupt.h
+
+extern volatile unsigned char PMIC_CTRL;
+extern volatile unsigned char SREG;
+
+#define TC_CLKSEL_DIV64_gc		0x05
+#define TC_OVFINTLVL_LO_gc		0x01
+#define PMIC_LOLVLEN_bm			0x01
+
+#endif /* HOST_AVR_IO_H_ */
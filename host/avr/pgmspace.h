@@ -0,0 +1,17 @@
+/**
+ * @brief   avr/pgmspace.h replacement for host builds, flash and RAM share one address space
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)				(s)
+#define pgm_read_byte(p)	(*(const unsigned char *)(p))
+#define pgm_read_word(p)	(*(const unsigned short *)(p))
+#define strlen_P(s)			strlen(s)
+#define memcpy_P(d, s, n)	memcpy(d, s, n)
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
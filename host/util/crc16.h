@@ -0,0 +1,23 @@
+/**
+ * @brief   util/crc16.h replacement for host builds, same results as the avr-libc inline assembler
+ */
+
+#ifndef HOST_UTIL_CRC16_H_
+#define HOST_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+static inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+	unsigned char i;
+
+	crc ^= (uint16_t)data << 8;
+	for(i=0; i<8; i++)
+	{
+		if(crc & 0x8000)	crc = (crc << 1) ^ 0x1021;
+		else				crc <<= 1;
+	}
+	return crc;
+}
+
+#endif /* HOST_UTIL_CRC16_H_ */
@@ -0,0 +1,13 @@
+/**
+ * @brief   util/delay.h replacement for host builds, busy waits only advance modeled time
+ */
+
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+#include "W5500-sim.h"
+
+#define _delay_us(us)	w5500simDelayUs(us)
+#define _delay_ms(ms)	w5500simDelayUs((ms) * 1000.0)
+
+#endif /* HOST_UTIL_DELAY_H_ */